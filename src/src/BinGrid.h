@@ -0,0 +1,129 @@
+#ifndef BINGRID_H
+#define BINGRID_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+/**
+ * @brief Row-major 2D grid of bins, a view into memory owned by a GridArena
+ *
+ * grid[y][x] is the bin in row y and column x. The data starts on a 64-byte boundary and
+ * the rows are contiguous, so a whole grid can also be swept as one flat array of size().
+ *
+ * @tparam T Type of the bin values
+ */
+template <typename T>
+class BinGrid {
+   public:
+    /////////////////////////////////
+    // Constructors
+    /////////////////////////////////
+
+    BinGrid() = default;
+    BinGrid(T *data, int rows, int cols) : data_(data), rows_(rows), cols_(cols) {}
+
+    /////////////////////////////////
+    // Accessors
+    /////////////////////////////////
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    size_t size() const { return size_t(rows_) * cols_; }
+
+    T *data() { return data_; }
+    const T *data() const { return data_; }
+
+    // Start of row y
+    T *operator[](int y) { return data_ + size_t(y) * cols_; }
+    const T *operator[](int y) const { return data_ + size_t(y) * cols_; }
+
+    /////////////////////////////////
+    // Methods
+    /////////////////////////////////
+
+    void fill(const T &value) { std::fill(data_, data_ + size(), value); }
+
+   private:
+    /////////////////////////////////
+    // Data members
+    /////////////////////////////////
+
+    T *data_ = nullptr;
+    int rows_ = 0;
+    int cols_ = 0;
+};
+
+/**
+ * @brief Fixed-capacity bump allocator for the bin grids of one density function
+ *
+ * The capacity is reserved up front as a single zeroed, 64-byte-aligned block, and every
+ * grid is carved out of it at its own 64-byte boundary. Grids live as long as the arena;
+ * nothing is freed individually, so the owner allocates all its grids once and reuses
+ * them. The arena cannot be copied, which also keeps its owner from being copied with
+ * grids that point into another object's memory.
+ */
+class GridArena {
+   public:
+    static constexpr size_t kAlignment = 64;
+
+    /////////////////////////////////
+    // Constructors
+    /////////////////////////////////
+
+    explicit GridArena(size_t capacity)
+        : capacity_(roundUp(capacity)), memory_(static_cast<char *>(std::aligned_alloc(kAlignment, std::max(capacity_, kAlignment)))) {
+        assert(memory_ && "GridArena: allocation failed");
+        std::memset(memory_.get(), 0, capacity_);
+    }
+
+    GridArena(const GridArena &) = delete;
+    GridArena &operator=(const GridArena &) = delete;
+
+    /////////////////////////////////
+    // Accessors
+    /////////////////////////////////
+
+    size_t capacity() const { return capacity_; }
+    size_t used() const { return used_; }
+
+    /////////////////////////////////
+    // Methods
+    /////////////////////////////////
+
+    // Bytes that allocate<T>(rows, cols) takes from the arena
+    template <typename T>
+    static size_t bytes(int rows, int cols) {
+        return roundUp(size_t(rows) * cols * sizeof(T));
+    }
+
+    // Carve a zeroed rows x cols grid out of the arena
+    template <typename T>
+    BinGrid<T> allocate(int rows, int cols) {
+        const size_t n = bytes<T>(rows, cols);
+        assert(used_ + n <= capacity_ && "GridArena: capacity exceeded");
+        T *data = reinterpret_cast<T *>(memory_.get() + used_);
+        used_ += n;
+        return BinGrid<T>(data, rows, cols);
+    }
+
+   private:
+    struct Free {
+        void operator()(char *p) const { std::free(p); }
+    };
+
+    static size_t roundUp(size_t n) { return (n + kAlignment - 1) / kAlignment * kAlignment; }
+
+    /////////////////////////////////
+    // Data members
+    /////////////////////////////////
+
+    size_t capacity_;
+    size_t used_ = 0;
+    std::unique_ptr<char, Free> memory_;
+};
+
+#endif  // BINGRID_H
@@ -0,0 +1,105 @@
+#ifndef BININDEX_H
+#define BININDEX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "Point.h"
+
+/**
+ * @brief Spatial index from the bins of a grid to the modules whose center lies in them
+ *
+ * The modules are kept in CSR form: bin b = by * cols + bx owns modules()[offset(b),
+ * offset(b + 1)), in ascending module order, and the bins follow each other row by row, so
+ * the modules of a band of rows [y0, y1) are the contiguous range [offset(y0 * cols),
+ * offset(y1 * cols)). Centers outside the grid count towards the nearest border bin.
+ * build() is a counting sort in O(modules + bins) and allocates nothing once the index has
+ * seen the largest module count.
+ */
+class BinIndex {
+   public:
+    /////////////////////////////////
+    // Constructors
+    /////////////////////////////////
+
+    BinIndex() = default;
+    BinIndex(int rows, int cols, double left, double bottom, double bin_width, double bin_height)
+        : rows_(rows), cols_(cols), left_(left), bottom_(bottom), bin_width_(bin_width), bin_height_(bin_height),
+          offsets_(size_t(rows) * cols + 1, 0) {}
+
+    /////////////////////////////////
+    // Accessors
+    /////////////////////////////////
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+
+    // Bin of a coordinate, clamped to the grid
+    int binX(double x) const { return std::min(std::max((int)std::floor((x - left_) / bin_width_), 0), cols_ - 1); }
+    int binY(double y) const { return std::min(std::max((int)std::floor((y - bottom_) / bin_height_), 0), rows_ - 1); }
+
+    // Modules of bin b are modules()[offset(b), offset(b + 1))
+    size_t offset(size_t b) const { return offsets_[b]; }
+    const size_t *modules() const { return modules_.data(); }
+    size_t numModules() const { return offsets_.back(); }
+
+    // Modules of bin (by, bx)
+    const size_t *begin(int by, int bx) const { return modules_.data() + offsets_[size_t(by) * cols_ + bx]; }
+    const size_t *end(int by, int bx) const { return modules_.data() + offsets_[size_t(by) * cols_ + bx + 1]; }
+    size_t count(int by, int bx) const { return end(by, bx) - begin(by, bx); }
+
+    /////////////////////////////////
+    // Methods
+    /////////////////////////////////
+
+    // Index the modules i with skip(i) false by their center
+    template <typename T, typename Skip>
+    void build(const std::vector<Point2<T>> &centers, Skip skip) {
+        const size_t num_modules = centers.size();
+        bin_of_.resize(num_modules);
+        std::fill(offsets_.begin(), offsets_.end(), 0);
+        for (size_t i = 0; i < num_modules; ++i) {
+            if (skip(i)) continue;
+            bin_of_[i] = size_t(binY(centers[i].y)) * cols_ + binX(centers[i].x);
+            ++offsets_[bin_of_[i] + 1];
+        }
+        for (size_t b = 0; b + 1 < offsets_.size(); ++b) {
+            offsets_[b + 1] += offsets_[b];
+        }
+        modules_.resize(offsets_.back());
+        fill_.assign(offsets_.begin(), offsets_.end() - 1);
+        for (size_t i = 0; i < num_modules; ++i) {
+            if (!skip(i)) modules_[fill_[bin_of_[i]]++] = i;
+        }
+    }
+
+    // Call visit(i) for every module indexed in a bin that overlaps [left, right] x [bottom, top];
+    // the caller filters by exact position if it needs to
+    template <typename Visitor>
+    void forEachModule(double left, double bottom, double right, double top, Visitor visit) const {
+        const int bx_min = binX(left), bx_max = binX(right);
+        const int by_min = binY(bottom), by_max = binY(top);
+        for (int by = by_min; by <= by_max; ++by) {
+            const size_t *first = begin(by, bx_min), *last = end(by, bx_max);
+            for (const size_t *m = first; m != last; ++m) visit(*m);
+        }
+    }
+
+   private:
+    /////////////////////////////////
+    // Data members
+    /////////////////////////////////
+
+    int rows_ = 0, cols_ = 0;
+    double left_ = 0.0, bottom_ = 0.0;
+    double bin_width_ = 1.0, bin_height_ = 1.0;
+
+    std::vector<size_t> offsets_ = std::vector<size_t>(1, 0);
+    std::vector<size_t> modules_;
+    std::vector<size_t> bin_of_;  // Bin of every indexed module during build()
+    std::vector<size_t> fill_;    // Next free slot of every bin during build()
+};
+
+#endif  // BININDEX_H
@@ -0,0 +1,100 @@
+#include "FFT.h"
+
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+FFT::FFT(size_t n) : n_(n), bitrev_(n), twiddle_(n / 2), shift_(n), work_(n), real_work_(n) {
+    assert(n > 0 && (n & (n - 1)) == 0 && "FFT length must be a power of two");
+
+    size_t bits = 0;
+    while ((size_t(1) << bits) < n) ++bits;
+    for (size_t i = 0; i < n; ++i) {
+        size_t r = 0;
+        for (size_t b = 0; b < bits; ++b) {
+            if (i & (size_t(1) << b)) r |= size_t(1) << (bits - 1 - b);
+        }
+        bitrev_[i] = r;
+    }
+    for (size_t k = 0; k < n / 2; ++k) {
+        twiddle_[k] = std::polar(1.0, -2.0 * M_PI * k / n);
+    }
+    for (size_t u = 0; u < n; ++u) {
+        shift_[u] = std::polar(1.0, -M_PI * u / (2.0 * n));
+    }
+}
+
+size_t FFT::roundUp(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+void FFT::transform(std::complex<double> *data, bool inverse) {
+    for (size_t i = 0; i < n_; ++i) {
+        if (i < bitrev_[i]) std::swap(data[i], data[bitrev_[i]]);
+    }
+    for (size_t len = 2; len <= n_; len <<= 1) {
+        const size_t half = len / 2, stride = n_ / len;
+        for (size_t i = 0; i < n_; i += len) {
+            for (size_t j = 0; j < half; ++j) {
+                const std::complex<double> w = inverse ? std::conj(twiddle_[j * stride]) : twiddle_[j * stride];
+                const std::complex<double> u = data[i + j];
+                const std::complex<double> v = data[i + j + half] * w;
+                data[i + j] = u + v;
+                data[i + j + half] = u - v;
+            }
+        }
+    }
+}
+
+/**
+ * @details With v[k] = x[2k] and v[n-1-k] = x[2k+1] for k < n/2, and V the FFT of v,
+ *      dct(x)[u] = Re(exp(-i pi u / (2n)) V[u]).
+ */
+void FFT::dct(const double *in, double *out) {
+    for (size_t k = 0; k < n_ / 2; ++k) {
+        work_[k] = in[2 * k];
+        work_[n_ - 1 - k] = in[2 * k + 1];
+    }
+    if (n_ == 1) work_[0] = in[0];
+    transform(work_.data(), /*inverse=*/false);
+    for (size_t u = 0; u < n_; ++u) {
+        out[u] = (shift_[u] * work_[u]).real();
+    }
+}
+
+/**
+ * @details Inverts the reordering of dct(): for the DCT-II coefficients c of a sequence x,
+ *      V[u] = exp(i pi u / (2n)) (c[u] - i c[n-u])   with c[n] = 0
+ * is the FFT of the reordered x. Since idct(a) = n * dct^-1(c) with c[0] = a[0] and
+ * c[u] = a[u] / 2 otherwise, the unnormalized inverse FFT yields idct(a) directly.
+ */
+void FFT::idct(const double *in, double *out) {
+    for (size_t u = 0; u < n_; ++u) {
+        const double c = u == 0 ? in[0] : 0.5 * in[u];
+        const double c_mirror = u == 0 ? 0.0 : 0.5 * in[n_ - u];
+        work_[u] = std::conj(shift_[u]) * std::complex<double>(c, -c_mirror);
+    }
+    transform(work_.data(), /*inverse=*/true);
+    for (size_t k = 0; k < n_ / 2; ++k) {
+        out[2 * k] = work_[k].real();
+        out[2 * k + 1] = work_[n_ - 1 - k].real();
+    }
+    if (n_ == 1) out[0] = work_[0].real();
+}
+
+/**
+ * @details sin(pi u (k + 1/2) / n) = (-1)^k cos(pi (n - u) (k + 1/2) / n), so the sine sum
+ * is a cosine sum over the reversed coefficients with alternating signs.
+ */
+void FFT::idst(const double *in, double *out) {
+    real_work_[0] = 0.0;
+    for (size_t u = 1; u < n_; ++u) {
+        real_work_[u] = in[n_ - u];
+    }
+    idct(real_work_.data(), out);
+    for (size_t k = 1; k < n_; k += 2) {
+        out[k] = -out[k];
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Radix-2 FFT and the cosine/sine transforms built on it, for one power-of-two length
+ *
+ * The plan holds the twiddle factors, the bit-reversal permutation and its own scratch
+ * buffers, so repeated transforms allocate nothing. A plan must therefore not be shared
+ * between threads. All transforms are unnormalized, for k, u in [0, n):
+ *      dct(x)[u]  = sum_k x[k] cos(pi u (k + 1/2) / n)      (DCT-II)
+ *      idct(a)[k] = sum_u a[u] cos(pi u (k + 1/2) / n)      (DCT-III)
+ *      idst(a)[k] = sum_u a[u] sin(pi u (k + 1/2) / n)
+ * The cosine transforms use Makhoul's reordering, so each costs one complex FFT of length n.
+ */
+class FFT {
+   public:
+    /////////////////////////////////
+    // Constructors
+    /////////////////////////////////
+
+    explicit FFT(size_t n);
+
+    /////////////////////////////////
+    // Accessors
+    /////////////////////////////////
+
+    size_t size() const { return n_; }
+
+    /////////////////////////////////
+    // Methods
+    /////////////////////////////////
+
+    // In-place complex FFT, with exp(-2 pi i jk / n) forward and exp(+2 pi i jk / n) inverse
+    void transform(std::complex<double> *data, bool inverse);
+
+    // Real transforms of n values; in and out may alias
+    void dct(const double *in, double *out);
+    void idct(const double *in, double *out);
+    void idst(const double *in, double *out);
+
+    // Smallest power of two that is at least n
+    static size_t roundUp(size_t n);
+
+   private:
+    /////////////////////////////////
+    // Data members
+    /////////////////////////////////
+
+    size_t n_;
+    std::vector<size_t> bitrev_;                 // Bit-reversal permutation
+    std::vector<std::complex<double>> twiddle_;  // exp(-2 pi i k / n) for k < n/2
+    std::vector<std::complex<double>> shift_;    // exp(-i pi u / (2n)) for u < n
+    std::vector<std::complex<double>> work_;
+    std::vector<double> real_work_;
+};
+
+#endif  // FFT_H
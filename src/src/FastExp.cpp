@@ -0,0 +1,157 @@
+#include "FastExp.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+// GCC 12 flags the _mm512_undefined_*() placeholders inside the AVX-512 intrinsics (PR105593)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+namespace {
+
+constexpr double kLog2e = 1.4426950408889634;
+constexpr double kLn2Hi = 6.93147180369123816490e-01;  // ln2 split so that k*kLn2Hi is exact
+constexpr double kLn2Lo = 1.90821492927058770002e-10;
+constexpr double kMinArg = -708.0;
+constexpr double kMaxArg = 709.0;
+constexpr double kRoundMagic = 6755399441055744.0;  // 1.5 * 2^52, rounds to integer when added
+
+// Taylor coefficients 1/k! for k = 13 down to 0 (Horner order)
+constexpr double kCoeff[] = {
+    1.0 / 6227020800.0, 1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0, 1.0 / 362880.0,
+    1.0 / 40320.0,      1.0 / 5040.0,      1.0 / 720.0,      1.0 / 120.0,     1.0 / 24.0,
+    1.0 / 6.0,          0.5,               1.0,              1.0,
+};
+constexpr int kNumCoeff = sizeof(kCoeff) / sizeof(kCoeff[0]);
+
+void fastExpScalar(const double *in, double *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        const double x = in[i];
+        out[i] = x < kMinArg ? 0.0 : x > kMaxArg ? INFINITY : std::exp(x);  // The range of the vector paths
+    }
+}
+
+__attribute__((target("avx2,fma"))) void fastExpAvx2(const double *in, double *out, size_t n) {
+    const __m256d log2e = _mm256_set1_pd(kLog2e);
+    const __m256d ln2_hi = _mm256_set1_pd(kLn2Hi);
+    const __m256d ln2_lo = _mm256_set1_pd(kLn2Lo);
+    const __m256d min_arg = _mm256_set1_pd(kMinArg);
+    const __m256d max_arg = _mm256_set1_pd(kMaxArg);
+    const __m256d magic = _mm256_set1_pd(kRoundMagic);
+    const __m256d inf = _mm256_set1_pd(INFINITY);
+    const __m256i bias = _mm256_set1_epi64x(1023);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256d x = _mm256_loadu_pd(in + i);
+        const __m256d xc = _mm256_min_pd(_mm256_max_pd(x, min_arg), max_arg);
+
+        // k = round(x / ln2), r = x - k*ln2
+        const __m256d t = _mm256_fmadd_pd(xc, log2e, magic);
+        const __m256d k = _mm256_sub_pd(t, magic);
+        __m256d r = _mm256_fnmadd_pd(k, ln2_hi, xc);
+        r = _mm256_fnmadd_pd(k, ln2_lo, r);
+
+        __m256d p = _mm256_set1_pd(kCoeff[0]);
+        for (int c = 1; c < kNumCoeff; ++c) {
+            p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(kCoeff[c]));
+        }
+
+        // 2^k from the low bits of t, which hold k as an integer
+        const __m256i e = _mm256_slli_epi64(_mm256_add_epi64(_mm256_castpd_si256(t), bias), 52);
+        __m256d y = _mm256_mul_pd(p, _mm256_castsi256_pd(e));
+
+        y = _mm256_andnot_pd(_mm256_cmp_pd(x, min_arg, _CMP_LT_OQ), y);
+        y = _mm256_blendv_pd(y, inf, _mm256_cmp_pd(x, max_arg, _CMP_GT_OQ));
+        _mm256_storeu_pd(out + i, y);
+    }
+    if (i < n) {
+        double in_tail[4] = {0.0, 0.0, 0.0, 0.0}, out_tail[4];
+        for (size_t j = i; j < n; ++j) in_tail[j - i] = in[j];
+        fastExpAvx2(in_tail, out_tail, 4);
+        for (size_t j = i; j < n; ++j) out[j] = out_tail[j - i];
+    }
+}
+
+__attribute__((target("avx512f"))) void fastExpAvx512(const double *in, double *out, size_t n) {
+    const __m512d log2e = _mm512_set1_pd(kLog2e);
+    const __m512d ln2_hi = _mm512_set1_pd(kLn2Hi);
+    const __m512d ln2_lo = _mm512_set1_pd(kLn2Lo);
+    const __m512d min_arg = _mm512_set1_pd(kMinArg);
+    const __m512d max_arg = _mm512_set1_pd(kMaxArg);
+    const __m512d magic = _mm512_set1_pd(kRoundMagic);
+    const __m512d inf = _mm512_set1_pd(INFINITY);
+    const __m512i bias = _mm512_set1_epi64(1023);
+
+    for (size_t i = 0; i < n; i += 8) {
+        const __mmask8 lanes = (n - i >= 8) ? 0xFF : (__mmask8)((1u << (n - i)) - 1);
+        const __m512d x = _mm512_maskz_loadu_pd(lanes, in + i);
+        const __m512d xc = _mm512_min_pd(_mm512_max_pd(x, min_arg), max_arg);
+
+        // k = round(x / ln2), r = x - k*ln2
+        const __m512d t = _mm512_fmadd_pd(xc, log2e, magic);
+        const __m512d k = _mm512_sub_pd(t, magic);
+        __m512d r = _mm512_fnmadd_pd(k, ln2_hi, xc);
+        r = _mm512_fnmadd_pd(k, ln2_lo, r);
+
+        __m512d p = _mm512_set1_pd(kCoeff[0]);
+        for (int c = 1; c < kNumCoeff; ++c) {
+            p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(kCoeff[c]));
+        }
+
+        // 2^k from the low bits of t, which hold k as an integer
+        const __m512i e = _mm512_slli_epi64(_mm512_add_epi64(_mm512_castpd_si512(t), bias), 52);
+        __m512d y = _mm512_mul_pd(p, _mm512_castsi512_pd(e));
+
+        y = _mm512_maskz_mov_pd(_mm512_cmp_pd_mask(x, min_arg, _CMP_GE_OQ), y);
+        y = _mm512_mask_mov_pd(y, _mm512_cmp_pd_mask(x, max_arg, _CMP_GT_OQ), inf);
+        _mm512_mask_storeu_pd(out + i, lanes, y);
+    }
+}
+
+struct FastExpDispatch {
+    FastExpKernel kernel;
+    const char *isa;
+
+    FastExpDispatch() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            kernel = fastExpAvx512;
+            isa = "avx512";
+        } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            kernel = fastExpAvx2;
+            isa = "avx2";
+        } else {
+            kernel = fastExpScalar;
+            isa = "scalar";
+        }
+    }
+};
+
+const FastExpDispatch &dispatch() {
+    static const FastExpDispatch instance;
+    return instance;
+}
+
+}  // namespace
+
+void fastExp(const double *in, double *out, size_t n) {
+    dispatch().kernel(in, out, n);
+}
+
+const char *fastExpIsa() {
+    return dispatch().isa;
+}
+
+FastExpKernel fastExpKernel(const char *isa) {
+    dispatch();  // Runs __builtin_cpu_init()
+    if (std::strcmp(isa, "avx512") == 0) {
+        return __builtin_cpu_supports("avx512f") ? fastExpAvx512 : nullptr;
+    }
+    if (std::strcmp(isa, "avx2") == 0) {
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? fastExpAvx2 : nullptr;
+    }
+    if (std::strcmp(isa, "scalar") == 0) return fastExpScalar;
+    return nullptr;
+}
@@ -0,0 +1,88 @@
+#include "FlatNetlist.h"
+
+#include <algorithm>
+#include <limits>
+
+FlatNetlist::FlatNetlist(Placement &placement)
+    : boundry_left_(placement.boundryLeft()),
+      boundry_right_(placement.boundryRight()),
+      boundry_bottom_(placement.boundryBottom()),
+      boundry_top_(placement.boundryTop()) {
+    const size_t num_modules = placement.numModules();
+    module_fixed_.resize(num_modules);
+    module_width_.resize(num_modules);
+    module_height_.resize(num_modules);
+    for (size_t i = 0; i < num_modules; ++i) {
+        Module &mod = placement.module(i);
+        module_fixed_[i] = mod.isFixed();
+        module_width_[i] = mod.width();
+        module_height_[i] = mod.height();
+        if (mod.isFixed()) fixed_rectangles_.push_back(mod.rectangle());
+    }
+
+    const size_t num_nets = placement.numNets();
+    net_offsets_.reserve(num_nets + 1);
+    pin_module_.reserve(placement.numPins());
+    pin_net_.reserve(placement.numPins());
+    pin_offset_x_.reserve(placement.numPins());
+    pin_offset_y_.reserve(placement.numPins());
+
+    net_offsets_.push_back(0);
+    for (size_t netId = 0; netId < num_nets; ++netId) {
+        Net &net = placement.net(netId);
+        for (size_t k = 0; k < net.numPins(); ++k) {
+            Pin &pin = net.pin(k);
+            const int moduleId = pin.moduleId();
+            Module &mod = placement.module(moduleId);
+            pin_net_.push_back(netId);
+            if (mod.isFixed()) {
+                pin_module_.push_back(kFixed);
+                pin_offset_x_.push_back(pin.x());
+                pin_offset_y_.push_back(pin.y());
+            } else {
+                pin_module_.push_back(moduleId);
+                pin_offset_x_.push_back(pin.x() - mod.centerX());
+                pin_offset_y_.push_back(pin.y() - mod.centerY());
+            }
+        }
+        net_offsets_.push_back(pin_module_.size());
+    }
+
+    // Transpose into module -> pins with a counting sort, which keeps the pins in order
+    module_pin_offsets_.assign(num_modules + 1, 0);
+    for (size_t p = 0; p < numPins(); ++p) {
+        if (pin_module_[p] != kFixed) ++module_pin_offsets_[pin_module_[p] + 1];
+    }
+    for (size_t i = 0; i < num_modules; ++i) {
+        module_pin_offsets_[i + 1] += module_pin_offsets_[i];
+    }
+    module_pins_.resize(module_pin_offsets_[num_modules]);
+    std::vector<size_t> fill(module_pin_offsets_.begin(), module_pin_offsets_.end() - 1);
+    for (size_t p = 0; p < numPins(); ++p) {
+        if (pin_module_[p] != kFixed) module_pins_[fill[pin_module_[p]]++] = p;
+    }
+}
+
+template <typename T>
+double FlatNetlist::hpwl(const std::vector<Point2<T>> &pos) const {
+    double total = 0.0;
+    for (size_t netId = 0; netId < numNets(); ++netId) {
+        const size_t begin = netBegin(netId), end = netEnd(netId);
+        if (begin == end) continue;
+
+        double x_min = std::numeric_limits<double>::max(), x_max = std::numeric_limits<double>::lowest();
+        double y_min = std::numeric_limits<double>::max(), y_max = std::numeric_limits<double>::lowest();
+        for (size_t p = begin; p < end; ++p) {
+            const double x = pinX(p, pos), y = pinY(p, pos);
+            x_min = std::min(x_min, x);
+            x_max = std::max(x_max, x);
+            y_min = std::min(y_min, y);
+            y_max = std::max(y_max, y);
+        }
+        total += (x_max - x_min) + (y_max - y_min);
+    }
+    return total;
+}
+
+template double FlatNetlist::hpwl(const std::vector<Point2<float>> &pos) const;
+template double FlatNetlist::hpwl(const std::vector<Point2<double>> &pos) const;
@@ -0,0 +1,109 @@
+#define _GLIBCXX_USE_CXX11_ABI 0  // Align the ABI version to avoid compatibility issues with `Placment.h`
+#ifndef FLATNETLIST_H
+#define FLATNETLIST_H
+
+#include <vector>
+
+#include "Placement.h"
+#include "Point.h"
+
+/**
+ * @brief Immutable, flat (CSR) snapshot of the netlist for the global placement kernels
+ *
+ * Built once from the placement database. The pins of net n occupy the index range
+ * [netBegin(n), netEnd(n)) of the pin arrays, in the same order as Net::pin(). For a pin on
+ * a movable module, pinModule() is the module index and pinOffsetX/Y() is the offset of the
+ * pin from the module center. For a pin on a fixed module, pinModule() is kFixed and
+ * pinOffsetX/Y() already holds the absolute pin coordinates, so pinX()/pinY() need no access
+ * to the module at all. The transposed index lists, for every movable module, its pins in
+ * ascending pin order. The rectangles of the fixed modules are kept for the density
+ * functions, which account for them once at construction.
+ */
+class FlatNetlist {
+   public:
+    static constexpr int kFixed = -1;  // pinModule() of a pin on a fixed module
+
+    /////////////////////////////////
+    // Constructors
+    /////////////////////////////////
+
+    explicit FlatNetlist(Placement &placement);
+
+    /////////////////////////////////
+    // Accessors
+    /////////////////////////////////
+
+    size_t numModules() const { return module_width_.size(); }
+    size_t numNets() const { return net_offsets_.size() - 1; }
+    size_t numPins() const { return pin_module_.size(); }
+
+    // Pins of a net
+    size_t netBegin(size_t netId) const { return net_offsets_[netId]; }
+    size_t netEnd(size_t netId) const { return net_offsets_[netId + 1]; }
+    size_t netDegree(size_t netId) const { return net_offsets_[netId + 1] - net_offsets_[netId]; }
+
+    // Pins
+    int pinModule(size_t pinId) const { return pin_module_[pinId]; }
+    size_t pinNet(size_t pinId) const { return pin_net_[pinId]; }
+    double pinOffsetX(size_t pinId) const { return pin_offset_x_[pinId]; }
+    double pinOffsetY(size_t pinId) const { return pin_offset_y_[pinId]; }
+    template <typename T>
+    double pinX(size_t pinId, const std::vector<Point2<T>> &pos) const {
+        const int m = pin_module_[pinId];
+        return (m == kFixed ? 0.0 : pos[m].x) + pin_offset_x_[pinId];
+    }
+    template <typename T>
+    double pinY(size_t pinId, const std::vector<Point2<T>> &pos) const {
+        const int m = pin_module_[pinId];
+        return (m == kFixed ? 0.0 : pos[m].y) + pin_offset_y_[pinId];
+    }
+
+    // Pins of a movable module, as indices into the pin arrays
+    size_t modulePinBegin(size_t moduleId) const { return module_pin_offsets_[moduleId]; }
+    size_t modulePinEnd(size_t moduleId) const { return module_pin_offsets_[moduleId + 1]; }
+    size_t modulePin(size_t k) const { return module_pins_[k]; }
+
+    // Modules
+    bool isFixed(size_t moduleId) const { return module_fixed_[moduleId]; }
+    double width(size_t moduleId) const { return module_width_[moduleId]; }
+    double height(size_t moduleId) const { return module_height_[moduleId]; }
+    double area(size_t moduleId) const { return module_width_[moduleId] * module_height_[moduleId]; }
+    const std::vector<Rectangle> &fixedRectangles() const { return fixed_rectangles_; }
+
+    // Placement region
+    double boundryLeft() const { return boundry_left_; }
+    double boundryRight() const { return boundry_right_; }
+    double boundryBottom() const { return boundry_bottom_; }
+    double boundryTop() const { return boundry_top_; }
+
+    /////////////////////////////////
+    // Methods
+    /////////////////////////////////
+
+    // Half-perimeter wirelength with the movable modules centered at pos
+    template <typename T>
+    double hpwl(const std::vector<Point2<T>> &pos) const;
+
+   private:
+    /////////////////////////////////
+    // Data members
+    /////////////////////////////////
+
+    std::vector<size_t> net_offsets_;   // Pins of net n are [net_offsets_[n], net_offsets_[n+1])
+    std::vector<int> pin_module_;       // Movable module of each pin, or kFixed
+    std::vector<size_t> pin_net_;       // Net of each pin
+    std::vector<double> pin_offset_x_;  // Offset from the module center, or absolute x if fixed
+    std::vector<double> pin_offset_y_;  // Offset from the module center, or absolute y if fixed
+
+    std::vector<size_t> module_pin_offsets_;  // Pins of module m are module_pins_[offsets[m] .. offsets[m+1])
+    std::vector<size_t> module_pins_;
+
+    std::vector<char> module_fixed_;
+    std::vector<double> module_width_;
+    std::vector<double> module_height_;
+    std::vector<Rectangle> fixed_rectangles_;  // Outlines of the fixed modules
+
+    double boundry_left_, boundry_right_, boundry_bottom_, boundry_top_;
+};
+
+#endif  // FLATNETLIST_H
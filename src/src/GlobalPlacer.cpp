@@ -1,17 +1,24 @@
 #include "GlobalPlacer.h"
 
+#include <cmath>
 #include <cstdio>
 #include <vector>
 #include <set>
 #include <algorithm>
+#include <memory>
 
+#include "FastExp.h"
+#include "FlatNetlist.h"
 #include "ObjectiveFunction.h"
 #include "Optimizer.h"
+#include "ParamPlacement.h"
 #include "Point.h"
+#include "ThreadPool.h"
 #include <random>
+#include <type_traits>
 
-GlobalPlacer::GlobalPlacer(Placement &placement)
-    : _placement(placement) {
+GlobalPlacer::GlobalPlacer(Placement &placement, const GlobalPlacerOptions &options)
+    : _placement(placement), _options(options) {
 }
 
 void GlobalPlacer::place(bool rand_place) {
@@ -30,17 +37,25 @@ void GlobalPlacer::place(bool rand_place) {
     // const size_t num_modules = _placement.numModules();
 
     const size_t num_modules = _placement.numModules();
-    std::vector<Point2<double>> t(num_modules);
 
     // Initialize random number generator once outside the loop
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    const unsigned seed = _options.seed >= 0 ? (unsigned)_options.seed : std::random_device()();
+    printf("INFO: random seed %u.\n", seed);
+    std::mt19937 gen(seed);
 
     if(rand_place == false)
     {
-        // Create small random offsets (±5% of chip size around center)
-        double offset_x = (_placement.boundryRight() - _placement.boundryLeft()) * 0.25;  // 5% of chip width
-        double offset_y = (_placement.boundryTop() - _placement.boundryBottom())* 0.25;    // 5% of chip height
+        if (_options.singlePrecision) {
+            placeAnalytical<float>(gen);
+        } else {
+            placeAnalytical<double>(gen);
+        }
+    }
+    else // if replace happens, apply random placement
+    {
+        std::vector<Point2<double>> t(num_modules);
+        double offset_x = (_placement.boundryRight() - _placement.boundryLeft()) * 0.5;  // 5% of chip width
+        double offset_y = (_placement.boundryTop() - _placement.boundryBottom())* 0.5;    // 5% of chip height
         std::uniform_real_distribution<> dis_x(-offset_x, offset_x);
         std::uniform_real_distribution<> dis_y(-offset_y, offset_y);
 
@@ -57,322 +72,436 @@ void GlobalPlacer::place(bool rand_place) {
                 center_x + dis_x(gen),
                 center_y + dis_y(gen)
             );
-            
+            _placement.module(i).setPosition(t[i].x, t[i].y);
+
             // print out the original position of all cells
             // cout << _placement.module(i).name() << " (" << t[i].x << ", " << t[i].y << ")" << endl;
         }
-    
-
-        // int bin_rows, bin_cols = (int)((_placement.boundryRight() - _placement.boundryLeft())/3); // 800 for ibm05
-        // int bin_rows = (int)((_placement.boundryRight() - _placement.boundryLeft())/3);
-        // int bin_cols = (int)((_placement.boundryRight() - _placement.boundryLeft())/3); 
-        int bin_rows = 200;
-        int bin_cols = 200;
-
-        Wirelength wirelength_(_placement, /*gamma=*/500.0);  // Wirelength function
-        Density density_(_placement, /*bin_rows=*/bin_rows, /*bin_cols=*/bin_cols, /*sigma_factor=*/1.5, /*target_density=*/0.9);  // Density function
-        ObjectiveFunction obj(_placement, /*lambda=*/0.0000000001, wirelength_, density_);
-
-        const double kAlpha = 5;                         // Constant step size
-        SimpleConjugateGradient optimizer(obj, t, kAlpha, _placement.boundryLeft(), _placement.boundryRight(), _placement.boundryTop(), _placement.boundryBottom());  // Optimizer
-
-        // Initialize the optimizer
-        optimizer.Initialize();
-
-
-        // Perform optimization, the termination condition is that the number of iterations reaches 100
-        // TODO: You may need to change the termination condition, which is determined by the overflow ratio.
-        // for (size_t i = 0; i < 100; ++i) {
-        //     optimizer.Step();
-        //     // printf("iter = %3lu, f = %9.4f, x = %9.4f, y = %9.4f\n", i, obj(t), t[0].x, t[0].y);
-        //     // printf("iter = %3lu, objective function value = %9.4f\n", i, obj(t));
-        //     // for (size_t j = 0; j < t.size(); ++j) {
-        //     //     if (_placement.module(j).isFixed()) continue;
-        //     //     // printf("iter %2lu, module %2zu: pos = (%.2f, %.2f)\n", i, j, t[i].x, t[i].y);
-        //     // }
-
-        //     // printf("iter %3lu: value = %.2f, WL = %.2f, DP = %.2f\n", i, obj(t), wirelength_(t), density_(t));
-        //     //plot the density during the optimization
-
-        // }
-        double init_lambda = 0.0000000001;
-        double lambda = init_lambda;
-        int i = -1;
-        do{
-            i++;
-            lambda *= 2;
-            obj.setLambda(max(lambda, init_lambda * 4000));
-            double min_density = std::numeric_limits<double>::max();
-            double max_density = std::numeric_limits<double>::lowest();
-            vector<vector<double>> bin_density = density_.getBinDensity();
-            if (i % 1 == 0) {
-                // Create output directory
-
-                int bin_rows = bin_density.size();
-                int bin_cols = bin_density[0].size();
-
-                // Histogram bins
-                int count_0_05 = 0, count_05_1 = 0, count_1_15 = 0, count_15_2 = 0;
-                int count_2_10 = 0, count_10_20 = 0, count_20_50 = 0, count_50_100 = 0, count_over_100 = 0;
-
-                for (int y = 0; y < bin_rows; ++y) {
-                    for (int x = 0; x < bin_cols; ++x) {
-                        double d = bin_density[y][x];
-
-                        // Update min/max
-                        min_density = std::min(min_density, d);
-                        max_density = std::max(max_density, d);
-
-                        // Histogram classification
-                        // if (d < 0.5) count_0_05++;
-                        // else if (d < 1.0) count_05_1++;
-                        // else if (d < 1.5) count_1_15++;
-                        // else if (d < 2.0) count_15_2++;
-                        // else if (d < 10.0) count_2_10++;
-                        // else if (d < 20.0) count_10_20++;
-                        // else if (d < 50.0) count_20_50++;
-                        // else if (d < 100.0) count_50_100++;
-                        // else count_over_100++;
-                    }
-                }
-                // cout << "Density Histogram:" << endl;
-                // cout << "  [0.0 ~ 0.5)    : " << count_0_05 << " bins" << endl;
-                // cout << "  [0.5 ~ 1.0)    : " << count_05_1 << " bins" << endl;
-                // cout << "  [1.0 ~ 1.5)    : " << count_1_15 << " bins" << endl;
-                // cout << "  [1.5 ~ 2.0)    : " << count_15_2 << " bins" << endl;
-                // cout << "  [2.0 ~ 10.0)   : " << count_2_10 << " bins" << endl;
-                // cout << "  [10.0 ~ 20.0)  : " << count_10_20 << " bins" << endl;
-                // cout << "  [20.0 ~ 50.0)  : " << count_20_50 << " bins" << endl;
-                // cout << "  [50.0 ~ 100.0) : " << count_50_100 << " bins" << endl;
-                // cout << "  [>100.0]       : " << count_over_100 << " bins" << endl;
-                // cout << "Min density      : " << min_density << endl;
-                cout << "iter = " << i << ", Max density : " << max_density << ", wirelength = " << wirelength_(t) << endl;
-
-
-
-                ////////////////////////////////////////////////////////////////////////////////////////
-                // Check if we have fixed and movable modules
-                
-                system("mkdir -p plot_output");
-                
-                ////////////////////////////////// Density Map Plot //////////////////////////////////
-                string densityname = "plot_output/density_" + std::to_string(i) + ".plt";
-                string densitypng = "plot_output/density_" + std::to_string(i) + ".png";
-                
-                ofstream densityfile(densityname.c_str(), ios::out);
-                densityfile << "set terminal png size 800,800 enhanced font 'Arial,12'" << endl;
-                densityfile << "set output '" << densitypng << "'" << endl;
-                densityfile << "set title \"Density Map - Iteration " << i << "\"" << endl;
-                densityfile << "set view map" << endl;
-                densityfile << "set size ratio 1" << endl;
-                densityfile << "unset key" << endl;
-                densityfile << "set palette defined (0 'white', 0.5 'yellow', 1 'red', 2 'dark-red')" << endl;
-                densityfile << "set cbrange [0:2]" << endl;
-                densityfile << "set cblabel 'Density'" << endl;
-                densityfile << "set xrange [0:" << bin_density[0].size()-1 << "]" << endl;
-                densityfile << "set yrange [0:" << bin_density.size()-1 << "]" << endl;
-
-                
-            
-                densityfile << "set pm3d map" << endl;
-                densityfile << "splot '-' using 1:2:3 notitle" << endl;
+        cout << "random placement done\n";
+    }
+}
 
-                for (size_t y = 0; y < bin_density.size(); ++y) {
-                    for (size_t x = 0; x < bin_density[y].size(); ++x) {
-                        densityfile << x << " " << y << " " << bin_density[y][x] << endl;
-                    }
-                    densityfile << endl;
-                }
-                densityfile << "e" << endl;
+/**
+ * @brief Analytical global placement: conjugate gradient on wirelength + lambda * density
+ *
+ * @tparam T Precision of the positions, gradients and density grids (float or double)
+ */
+template <typename T>
+void GlobalPlacer::placeAnalytical(std::mt19937 &gen) {
+    const size_t num_modules = _placement.numModules();
+    std::vector<Point2<T>> t(num_modules);
+
+
+    // Create small random offsets (±5% of chip size around center)
+    double offset_x = (_placement.boundryRight() - _placement.boundryLeft()) * 0.25;  // 5% of chip width
+    double offset_y = (_placement.boundryTop() - _placement.boundryBottom())* 0.25;    // 5% of chip height
+    std::uniform_real_distribution<> dis_x(-offset_x, offset_x);
+    std::uniform_real_distribution<> dis_y(-offset_y, offset_y);
+
+    // Center coordinates
+    double center_x = (_placement.boundryRight() + _placement.boundryLeft()) / 2;
+    double center_y = (_placement.boundryTop() + _placement.boundryBottom()) / 2;
+    cout << "center_x: " << center_x << ", center_y: " << center_y << endl;
+    // std::vector<Point2<double>> t(num_modules);
+    for (size_t i = 0; i < num_modules; ++i) {
+        if (_placement.module(i).isFixed()) continue;
+        
+        // Add small random offset to center position
+        t[i] = Point2<T>(
+            center_x + dis_x(gen),
+            center_y + dis_y(gen)
+        );
+        
+        // print out the original position of all cells
+        // cout << _placement.module(i).name() << " (" << t[i].x << ", " << t[i].y << ")" << endl;
+    }
 
-                densityfile.close();
-                
-                bool hasFixed = false;
-                bool hasMovable = false;
-                for (size_t j = 0; j < t.size(); ++j) {
-                    if (_placement.module(j).isFixed()) {
-                        hasFixed = true;
-                    } else {
-                        hasMovable = true;
-                    }
-                    if (hasFixed && hasMovable) break;
-                }
 
-                // Cell Distribution Plot
-                string cellname = "plot_output/cells_" + std::to_string(i) + ".plt";
-                string cellpng = "plot_output/cells_" + std::to_string(i) + ".png";
-
-                ofstream cellfile(cellname.c_str(), ios::out);
-                cellfile << "set terminal png size 800,800 enhanced font 'Arial,12'" << endl;
-                cellfile << "set output '" << cellpng << "'" << endl;
-                cellfile << "set title \"Cell Distribution - Iteration " << i 
-                        << "\\nWL = " << wirelength_(t) << ", DP = " << density_(t) << "\"" << endl;
-                cellfile << "set size ratio 1" << endl;
-                cellfile << "set xrange [" << _placement.boundryLeft() << ":" 
-                        << _placement.boundryRight() << "]" << endl;
-                cellfile << "set yrange [" << _placement.boundryBottom() << ":" 
-                        << _placement.boundryTop() << "]" << endl;
-
-                // Set point styles
-                cellfile << "set style line 1 lc rgb 'red' pt 7 ps 0.3" << endl;
-                cellfile << "set style line 2 lc rgb 'blue' pt 7 ps 0.3" << endl;
-                cellfile << "set style line 3 lc rgb 'black' lt 1 lw 2" << endl;
-
-                // Construct plot command based on what types of modules exist
-                string plotCmd = "plot ";
-                if (hasFixed) {
-                    plotCmd += "'-' w p ls 1 title 'Fixed'";
-                    if (hasMovable) plotCmd += ", ";
-                }
-                if (hasMovable) {
-                    plotCmd += "'-' w p ls 2 title 'Movable'";
-                }
-                plotCmd += ", '-' w l ls 3 title 'Boundary'";
-                cellfile << plotCmd << endl;
-
-                // Plot fixed modules if they exist
-                if (hasFixed) {
-                    for (size_t j = 0; j < t.size(); ++j) {
-                        if (_placement.module(j).isFixed()) {
-                            cellfile << t[j].x << " " << t[j].y << endl;
-                        }
-                    }
-                    cellfile << "e" << endl;
-                }
+    FlatNetlist netlist(_placement);                      // Flat netlist snapshot shared by the kernels
+    const BoxConstraint<T> box(netlist);                  // Placement region of every module
+    box.project(t);
 
-                // Plot movable modules if they exist
-                if (hasMovable) {
-                    for (size_t j = 0; j < t.size(); ++j) {
-                        if (!_placement.module(j).isFixed()) {
-                            cellfile << t[j].x << " " << t[j].y << endl;
-                        }
-                    }
-                    cellfile << "e" << endl;
-                }
+    // int bin_rows, bin_cols = (int)((_placement.boundryRight() - _placement.boundryLeft())/3); // 800 for ibm05
+    // int bin_rows = (int)((_placement.boundryRight() - _placement.boundryLeft())/3);
+    // int bin_cols = (int)((_placement.boundryRight() - _placement.boundryLeft())/3); 
+    constexpr int kCoarsestBins = 32;
+    const int final_bins = _options.densityBins > 0 ? _options.densityBins : autoBinCount(netlist);
+    std::vector<int> grid_bins;  // Bins per side of every grid, coarse to fine
+    if (_options.multiLevel) {
+        for (int bins = kCoarsestBins; bins < final_bins; bins *= 2) grid_bins.push_back(bins);
+    }
+    grid_bins.push_back(final_bins);
+
+    ThreadPool pool(max(1, param.threadNum));            // Workers for the parallel kernels
+    printf("INFO: %d thread(s), %s exp kernel.\n", (int)pool.numThreads(), fastExpIsa());
+    Wirelength<T> wirelength_(netlist, /*gamma=*/500.0);  // Wirelength function
+    wirelength_.setThreadPool(&pool);
+    wirelength_.setHighFanout(_options.hfMode, _options.hfThreshold, _options.hfPeriod);
+    wirelength_.setIncremental(_options.wlIncrementalTol);
+    std::unique_ptr<JacobiPreconditioner<T>> precond;
+    if (_options.precondition) precond.reset(new JacobiPreconditioner<T>(netlist));
+    PlacementProgress progress;
+    std::unique_ptr<TraceWriter> trace;
+    if (!_options.traceFile.empty()) {
+        trace.reset(new TraceWriter(_options.traceFile.c_str(), _options.traceEvery));
+        progress.trace = trace.get();
+    }
+    for (size_t level = 0; level < grid_bins.size(); ++level) {
+        const int bin_rows = grid_bins[level];
+        const int bin_cols = grid_bins[level];
+        const bool final_grid = level + 1 == grid_bins.size();
+        bool done;
+        if (_options.densityModel == DENSITY_ELECTROSTATIC) {
+            ElectrostaticDensity<T> density_(netlist, /*bin_rows=*/bin_rows, /*bin_cols=*/bin_cols, /*target_density=*/0.9);
+            printf("INFO: %d x %d density bins.\n", density_.getBinDensity().rows(), density_.getBinDensity().cols());
+            done = runGlobalPlacement(t, netlist, wirelength_, density_, precond.get(), box, progress, final_grid);
+        } else {
+            Density<T> density_(netlist, /*bin_rows=*/bin_rows, /*bin_cols=*/bin_cols, /*target_density=*/0.9);  // Density function
+            density_.setThreadPool(&pool);
+            density_.setPenalty(_options.densityModel == DENSITY_BELL_EXACT ? PENALTY_OVERFLOW : PENALTY_FIELD);
+            printf("INFO: %d x %d density bins.\n", bin_rows, bin_cols);
+            done = runGlobalPlacement(t, netlist, wirelength_, density_, precond.get(), box, progress, final_grid);
+        }
+        if (done) break;
+    }
+    printf("INFO: %d iterations, %zu objective evaluations.\n", progress.iteration, progress.evaluations);
+    wirelength_.reportHighFanoutStats();
+    wirelength_.reportIncrementalStats();
+    if (trace && trace->isOpen()) {
+        trace->close();
+        printf("INFO: %zu trace frame(s) written to %s.\n", trace->numFrames(), _options.traceFile.c_str());
+    }
 
-                // Always plot boundary
-                plotBoxPLT(cellfile, _placement.boundryLeft(), _placement.boundryBottom(), 
-                        _placement.boundryRight(), _placement.boundryTop());
-                cellfile << "e" << endl;
-                cellfile.close();
+    ////////////////////////////////////////////////////////////////////
+    // Global placement algorithm
+    ////////////////////////////////////////////////////////////////////
 
-                // Execute gnuplot
-                char cmd[256];
-                sprintf(cmd, "gnuplot %s %s", densityname.c_str(), cellname.c_str());
-                system(cmd);
+    // TODO: Implement your global placement algorithm here.
+    // const size_t num_modules = _placement.numModules();  // You may modify this line.
+    // std::vector<Point2<double>> positions(num_modules);  // Optimization variables (positions of modules). You may modify this line.
 
-                // Combine the two plots side by side
-                sprintf(cmd, "convert +append %s %s plot_output/combined_%zu.png", 
-                        densitypng.c_str(), cellpng.c_str(), i);
-                system(cmd);
+    ////////////////////////////////////////////////////////////////////
+    // Write the placement result into the database. (You may modify this part.)
+    ////////////////////////////////////////////////////////////////////
+    size_t fixed_cnt = 0;
+    // Clamp with the same boxes as the optimizer, so this only moves modules if the
+    // constraints were disabled. t holds module centers; setPosition() takes the lower-left corner.
+    const size_t num_in_chip_boundary = box.project(t);
+    for (size_t i = 0; i < num_modules; i++) {
+        // If the module is fixed, its position should not be changed.
+        // In this programing assignment, a fixed module may be a terminal or a pre-placed module.
+        if (_placement.module(i).isFixed()) {
+            fixed_cnt++;
+            continue;
+        }
 
-                printf("Generated plots for iteration %zu\n", i);
-                /////////////////////////////////////////////////////////////////////////////////////////////
-            }
+        _placement.module(i).setPosition(t[i].x - netlist.width(i) / 2, t[i].y - netlist.height(i) / 2);
+        // _placement.module(i).setPosition(center_x, center_y);
+
+        
+        
+
+        // /////////////////////////////////// random placement start ///////////////////////
+        // std::random_device rd;
+        // std::mt19937 gen(rd());
+        // std::uniform_real_distribution<> dis_x(_placement.boundryLeft(), _placement.boundryRight());
+        // std::uniform_real_distribution<> dis_y(_placement.boundryBottom(), _placement.boundryTop());
+        // // Get module dimensions to ensure it stays within boundaries
+        // double width = _placement.module(i).width();
+        // double height = _placement.module(i).height();
+        
+        // // Generate random position while keeping the module within chip boundaries
+        // double x = dis_x(gen);
+        // double y = dis_y(gen);
+        
+        // // Adjust if the module would go outside boundaries
+        // x = std::min(x, _placement.boundryRight() - width);
+        // y = std::min(y, _placement.boundryTop() - height);
+        // x = std::max(x, _placement.boundryLeft());
+        // y = std::max(y, _placement.boundryBottom());
+        
+        // _placement.module(i).setPosition(x, y);
+        // /////////////////////////////////// random placement end ///////////////////////
+
+
+        // print out the final position of all cells
+        // cout << _placement.module(i).name() << " (" << _placement.module(i).centerX() << ", " << _placement.module(i).centerY() << ")" << endl;
+    }
+    printf("INFO: %lu / %lu modules are fixed.\n", fixed_cnt, num_modules);
+    printf("INFO: %zu modules were out of the chip boundary and clamped.\n", num_in_chip_boundary);
+}
+
+/**
+ * @details About kBinsPerCell bins per movable cell, i.e. sqrt(kBinsPerCell * movable cells)
+ * bins per side, rounded to the nearest power of two so that the FFTs of the electrostatic
+ * density need no padding: ibm01 (12k cells) gets 256 x 256 bins and ibm09 (51k cells)
+ * 512 x 512.
+ */
+int GlobalPlacer::autoBinCount(const FlatNetlist &netlist) const {
+    constexpr double kBinsPerCell = 4.0;
+    constexpr int kMinBins = 32, kMaxBins = 1024;
+
+    size_t movable = 0;
+    for (size_t i = 0; i < netlist.numModules(); ++i) {
+        if (!netlist.isFixed(i)) ++movable;
+    }
+
+    const double side = std::sqrt(kBinsPerCell * movable);
+    int bins = kMinBins;
+    while (bins < kMaxBins && side > bins * M_SQRT2) bins *= 2;
+    return bins;
+}
 
-            optimizer.Step();
-            density_(t);
-            density_.setSmoothingDelta(max(1.0,  density_.getSmoothingDelta() * 0.9));
-            if(i != 0 && max_density < 12) break;
+/**
+ * @brief Minimize wirelength + lambda * density from the positions in t
+ *
+ * Stops once the overflow of the density function drops to the target overflow of the
+ * options, or after kMaxIterations in total.
+ *
+ * @tparam DensityFunction Density or ElectrostaticDensity. Lambda starts where the wirelength
+ *         and density gradients have equal norms (ePlace) and grows by kLambdaGrowth every
+ *         iteration. The field penalty of Density instead starts at kFieldLambda and doubles
+ *         every iteration, never below kFieldLambda * kFieldLambdaFloor.
+ * @param precond Preconditioner of the optimizer, or null; its lambda follows the objective's
+ * @param box Region of every module, enforced after each step if the options enable it
+ * @param progress Iteration count and lambda (growth), continued from the previous grid
+ * @param final_grid False for the coarse grids of the multi-level schedule, which also stop
+ *        once the overflow improved by less than kPlateauGain over kPlateauWindow iterations. A
+ *        finer grid balances the gradients again and applies the growth reached so far, since
+ *        the bell-shaped density does not keep its scale from one grid to the next.
+ * @return True if the iteration limit was reached and no further grid should run
+ */
+template <typename T, typename DensityFunction>
+bool GlobalPlacer::runGlobalPlacement(std::vector<Point2<T>> &t, const FlatNetlist &netlist, Wirelength<T> &wirelength_, DensityFunction &density_,
+                                      JacobiPreconditioner<T> *precond, const BoxConstraint<T> &box, PlacementProgress &progress, bool final_grid) {
+    constexpr double kLambdaGrowth = 1.05;
+    constexpr int kMaxIterations = 1000;
+    constexpr int kPlateauWindow = 10;
+    constexpr double kPlateauGain = 0.03;
+    constexpr double kFieldLambda = 1e-10;       // First density weight of the field penalty
+    constexpr double kFieldLambdaFloor = 4000;  // Its smallest weight, over kFieldLambda
+
+    ObjectiveFunction<T> obj(_placement, /*lambda=*/0.0000000001, wirelength_, density_);
+    bool field_penalty = false;  // Its gradient is not the slope of the value
+    if constexpr (std::is_same<DensityFunction, Density<T>>::value) field_penalty = density_.getPenalty() == PENALTY_FIELD;
+
+    const double kAlpha = 5;                         // Constant step size
+    std::unique_ptr<BaseOptimizer<T>> optimizer;  // Optimizer
+    if (_options.optimizer == OPTIMIZER_NESTEROV) {
+        optimizer.reset(new NesterovOptimizer<T>(obj, t, _placement.boundryLeft(), _placement.boundryRight(), _placement.boundryTop(), _placement.boundryBottom()));
+    } else if (_options.optimizer == OPTIMIZER_LBFGS) {
+        optimizer.reset(new LBFGSOptimizer<T>(obj, t, _options.lbfgsHistory, _placement.boundryLeft(), _placement.boundryRight(), _placement.boundryTop(), _placement.boundryBottom()));
+    } else {
+        SimpleConjugateGradient<T> *cg = new SimpleConjugateGradient<T>(obj, t, kAlpha, _placement.boundryLeft(), _placement.boundryRight(), _placement.boundryTop(), _placement.boundryBottom());
+        cg->setStepSize(_options.stepSize.value_or(field_penalty ? STEP_NORM : STEP_ARMIJO));
+        cg->setConjugate(!field_penalty);
+        optimizer.reset(cg);
+    }
+
+    // Initialize the optimizer
+    optimizer->Initialize();
+    optimizer->setTrace(progress.trace);
+    optimizer->setPreconditioner(precond);
+    if (_options.boxConstraint) optimizer->setBounds(&box);
+
+
+    // ePlace: start where the wirelength and density gradients have equal weight. This also
+    // leaves the overflow of the starting positions on this grid in density_.
+    wirelength_.ForwardBackward(t);
+    density_.ForwardBackward(t);
+    double wl_norm = 0.0, dp_norm = 0.0;
+    for (size_t j = 0; j < t.size(); ++j) {
+        wl_norm += std::abs(wirelength_.grad()[j].x) + std::abs(wirelength_.grad()[j].y);
+        dp_norm += std::abs(density_.grad()[j].x) + std::abs(density_.grad()[j].y);
+    }
+    const double balanced_lambda = dp_norm > 0 ? wl_norm / dp_norm : 1.0;
+
+    // The field penalty is normalized to [0, 1] on every grid, so its gradient gives no
+    // balanced weight. It doubles lambda instead, and since it sums over the bins, a finer grid
+    // scales lambda down by the ratio of the bin counts.
+    const int bins = density_.getBinDensity().rows() * density_.getBinDensity().cols();
+    double lambda = balanced_lambda * progress.growth;
+    if (field_penalty) lambda = progress.lambda > 0 ? progress.lambda * progress.bins / bins : kFieldLambda;
+    const int first_iteration = progress.iteration;
+    double plateau_reference = std::numeric_limits<double>::max();
+    bool done = false;
+    int i = first_iteration - 1;
+    do{
+        i++;
+        if (field_penalty) {
+            lambda *= 2;
+            obj.setLambda(std::max(lambda, kFieldLambda * kFieldLambdaFloor));
+        } else {
+            obj.setLambda(lambda);
+            lambda *= kLambdaGrowth;
+        }
+        if (precond) precond->setLambda(obj.getLambda());
+        const BinGrid<T> &bin_density = density_.getBinDensity();
+        cout << "iter = " << i << ", Max utilization : " << density_.getMaxUtilization() << ", HPWL = " << netlist.hpwl(t)
+             << ", Overflow = " << density_.getOverflow() << endl;
+        if (_options.plotEvery > 0 && i % _options.plotEvery == 0) {
+            // Create output directory
+
+            // Histogram bins
+            int count_0_05 = 0, count_05_1 = 0, count_1_15 = 0, count_15_2 = 0;
+            int count_2_10 = 0, count_10_20 = 0, count_20_50 = 0, count_50_100 = 0, count_over_100 = 0;
+
+            // cout << "Density Histogram:" << endl;
+            // cout << "  [0.0 ~ 0.5)    : " << count_0_05 << " bins" << endl;
+            // cout << "  [0.5 ~ 1.0)    : " << count_05_1 << " bins" << endl;
+            // cout << "  [1.0 ~ 1.5)    : " << count_1_15 << " bins" << endl;
+            // cout << "  [1.5 ~ 2.0)    : " << count_15_2 << " bins" << endl;
+            // cout << "  [2.0 ~ 10.0)   : " << count_2_10 << " bins" << endl;
+            // cout << "  [10.0 ~ 20.0)  : " << count_10_20 << " bins" << endl;
+            // cout << "  [20.0 ~ 50.0)  : " << count_20_50 << " bins" << endl;
+            // cout << "  [50.0 ~ 100.0) : " << count_50_100 << " bins" << endl;
+            // cout << "  [>100.0]       : " << count_over_100 << " bins" << endl;
+            // cout << "Min density      : " << min_density << endl;
+
+
+
+            ////////////////////////////////////////////////////////////////////////////////////////
+            // Check if we have fixed and movable modules
             
-        }while(true);
-
-        ////////////////////////////////////////////////////////////////////
-        // Global placement algorithm
-        ////////////////////////////////////////////////////////////////////
-
-        // TODO: Implement your global placement algorithm here.
-        // const size_t num_modules = _placement.numModules();  // You may modify this line.
-        // std::vector<Point2<double>> positions(num_modules);  // Optimization variables (positions of modules). You may modify this line.
-
-        ////////////////////////////////////////////////////////////////////
-        // Write the placement result into the database. (You may modify this part.)
-        ////////////////////////////////////////////////////////////////////
-        size_t fixed_cnt = 0;
-        int num_in_chip_boundary = 0;
-        for (size_t i = 0; i < num_modules; i++) {
-            // If the module is fixed, its position should not be changed.
-            // In this programing assignment, a fixed module may be a terminal or a pre-placed module.
-            if (_placement.module(i).isFixed()) {
-                fixed_cnt++;
-                continue;
-            }
+            system("mkdir -p plot_output");
+            
+            ////////////////////////////////// Density Map Plot //////////////////////////////////
+            string densityname = "plot_output/density_" + std::to_string(i) + ".plt";
+            string densitypng = "plot_output/density_" + std::to_string(i) + ".png";
+            
+            ofstream densityfile(densityname.c_str(), ios::out);
+            densityfile << "set terminal png size 800,800 enhanced font 'Arial,12'" << endl;
+            densityfile << "set output '" << densitypng << "'" << endl;
+            densityfile << "set title \"Density Map - Iteration " << i << "\"" << endl;
+            densityfile << "set view map" << endl;
+            densityfile << "set size ratio 1" << endl;
+            densityfile << "unset key" << endl;
+            densityfile << "set palette defined (0 'white', 0.5 'yellow', 1 'red', 2 'dark-red')" << endl;
+            densityfile << "set cbrange [0:2]" << endl;
+            densityfile << "set cblabel 'Density'" << endl;
+            densityfile << "set xrange [0:" << bin_density.cols()-1 << "]" << endl;
+            densityfile << "set yrange [0:" << bin_density.rows()-1 << "]" << endl;
+
+            
+        
+            densityfile << "set pm3d map" << endl;
+            densityfile << "splot '-' using 1:2:3 notitle" << endl;
 
-            if(t[i].x < _placement.boundryLeft() || t[i].x > _placement.boundryRight() ||
-            t[i].y < _placement.boundryBottom() || t[i].y > _placement.boundryTop()) {
-                num_in_chip_boundary++;
+            for (int y = 0; y < bin_density.rows(); ++y) {
+                for (int x = 0; x < bin_density.cols(); ++x) {
+                    densityfile << x << " " << y << " " << bin_density[y][x] << endl;
+                }
+                densityfile << endl;
             }
+            densityfile << "e" << endl;
 
+            densityfile.close();
+            
+            bool hasFixed = false;
+            bool hasMovable = false;
+            for (size_t j = 0; j < t.size(); ++j) {
+                if (_placement.module(j).isFixed()) {
+                    hasFixed = true;
+                } else {
+                    hasMovable = true;
+                }
+                if (hasFixed && hasMovable) break;
+            }
 
-            // clamp the position of the module to the chip boundary
-            t[i].x = max(_placement.boundryLeft() ,  min(t[i].x, _placement.boundryRight()));
-            t[i].y = max(_placement.boundryBottom(), min(t[i].y, _placement.boundryTop()));
+            // Cell Distribution Plot
+            string cellname = "plot_output/cells_" + std::to_string(i) + ".plt";
+            string cellpng = "plot_output/cells_" + std::to_string(i) + ".png";
+
+            ofstream cellfile(cellname.c_str(), ios::out);
+            cellfile << "set terminal png size 800,800 enhanced font 'Arial,12'" << endl;
+            cellfile << "set output '" << cellpng << "'" << endl;
+            cellfile << "set title \"Cell Distribution - Iteration " << i 
+                    << "\\nWL = " << wirelength_.value() << ", DP = " << density_.value() << "\"" << endl;
+            cellfile << "set size ratio 1" << endl;
+            cellfile << "set xrange [" << _placement.boundryLeft() << ":" 
+                    << _placement.boundryRight() << "]" << endl;
+            cellfile << "set yrange [" << _placement.boundryBottom() << ":" 
+                    << _placement.boundryTop() << "]" << endl;
+
+            // Set point styles
+            cellfile << "set style line 1 lc rgb 'red' pt 7 ps 0.3" << endl;
+            cellfile << "set style line 2 lc rgb 'blue' pt 7 ps 0.3" << endl;
+            cellfile << "set style line 3 lc rgb 'black' lt 1 lw 2" << endl;
+
+            // Construct plot command based on what types of modules exist
+            string plotCmd = "plot ";
+            if (hasFixed) {
+                plotCmd += "'-' w p ls 1 title 'Fixed'";
+                if (hasMovable) plotCmd += ", ";
+            }
+            if (hasMovable) {
+                plotCmd += "'-' w p ls 2 title 'Movable'";
+            }
+            plotCmd += ", '-' w l ls 3 title 'Boundary'";
+            cellfile << plotCmd << endl;
 
+            // Plot fixed modules if they exist
+            if (hasFixed) {
+                for (size_t j = 0; j < t.size(); ++j) {
+                    if (_placement.module(j).isFixed()) {
+                        cellfile << t[j].x << " " << t[j].y << endl;
+                    }
+                }
+                cellfile << "e" << endl;
+            }
 
-            _placement.module(i).setPosition(t[i].x, t[i].y);
-            // _placement.module(i).setPosition(center_x, center_y);
+            // Plot movable modules if they exist
+            if (hasMovable) {
+                for (size_t j = 0; j < t.size(); ++j) {
+                    if (!_placement.module(j).isFixed()) {
+                        cellfile << t[j].x << " " << t[j].y << endl;
+                    }
+                }
+                cellfile << "e" << endl;
+            }
 
-            
-            
+            // Always plot boundary
+            plotBoxPLT(cellfile, _placement.boundryLeft(), _placement.boundryBottom(), 
+                    _placement.boundryRight(), _placement.boundryTop());
+            cellfile << "e" << endl;
+            cellfile.close();
 
-            // /////////////////////////////////// random placement start ///////////////////////
-            // std::random_device rd;
-            // std::mt19937 gen(rd());
-            // std::uniform_real_distribution<> dis_x(_placement.boundryLeft(), _placement.boundryRight());
-            // std::uniform_real_distribution<> dis_y(_placement.boundryBottom(), _placement.boundryTop());
-            // // Get module dimensions to ensure it stays within boundaries
-            // double width = _placement.module(i).width();
-            // double height = _placement.module(i).height();
-            
-            // // Generate random position while keeping the module within chip boundaries
-            // double x = dis_x(gen);
-            // double y = dis_y(gen);
-            
-            // // Adjust if the module would go outside boundaries
-            // x = std::min(x, _placement.boundryRight() - width);
-            // y = std::min(y, _placement.boundryTop() - height);
-            // x = std::max(x, _placement.boundryLeft());
-            // y = std::max(y, _placement.boundryBottom());
-            
-            // _placement.module(i).setPosition(x, y);
-            // /////////////////////////////////// random placement end ///////////////////////
+            // Execute gnuplot
+            char cmd[256];
+            sprintf(cmd, "gnuplot %s %s", densityname.c_str(), cellname.c_str());
+            system(cmd);
 
+            // Combine the two plots side by side
+            sprintf(cmd, "convert +append %s %s plot_output/combined_%zu.png", 
+                    densitypng.c_str(), cellpng.c_str(), i);
+            system(cmd);
 
-            // print out the final position of all cells
-            // cout << _placement.module(i).name() << " (" << _placement.module(i).centerX() << ", " << _placement.module(i).centerY() << ")" << endl;
+            printf("Generated plots for iteration %zu\n", i);
+            /////////////////////////////////////////////////////////////////////////////////////////////
         }
-        printf("INFO: %lu / %lu modules are fixed.\n", fixed_cnt, num_modules);
-        cout << "INFO: " << num_in_chip_boundary << " modules are out of chip boundary." << endl;
-    }
-    else // if replace happens, apply random placement
-    {
-        double offset_x = (_placement.boundryRight() - _placement.boundryLeft()) * 0.5;  // 5% of chip width
-        double offset_y = (_placement.boundryTop() - _placement.boundryBottom())* 0.5;    // 5% of chip height
-        std::uniform_real_distribution<> dis_x(-offset_x, offset_x);
-        std::uniform_real_distribution<> dis_y(-offset_y, offset_y);
 
-        // Center coordinates
-        double center_x = (_placement.boundryRight() + _placement.boundryLeft()) / 2;
-        double center_y = (_placement.boundryTop() + _placement.boundryBottom()) / 2;
-        cout << "center_x: " << center_x << ", center_y: " << center_y << endl;
-        // std::vector<Point2<double>> t(num_modules);
-        for (size_t i = 0; i < num_modules; ++i) {
-            if (_placement.module(i).isFixed()) continue;
-            
-            // Add small random offset to center position
-            t[i] = Point2<double>(
-                center_x + dis_x(gen),
-                center_y + dis_y(gen)
-            );
-            _placement.module(i).setPosition(t[i].x, t[i].y);
+        // The overflow is that of the optimizer's last evaluation, at or next to t
+        optimizer->Step();
+        done = i + 1 >= kMaxIterations;
+        if (density_.getOverflow() <= _options.targetOverflow || done) break;
 
-            // print out the original position of all cells
-            // cout << _placement.module(i).name() << " (" << t[i].x << ", " << t[i].y << ")" << endl;
+        // Coarse grid: move on to the next one once the overflow stops improving
+        if (!final_grid && (i + 1 - first_iteration) % kPlateauWindow == 0) {
+            if (density_.getOverflow() > (1.0 - kPlateauGain) * plateau_reference) break;
+            plateau_reference = density_.getOverflow();
         }
-        cout << "random placement done\n";
-    }
+        
+    }while(true);
+
+    progress.iteration = i + 1;
+    progress.growth = lambda / balanced_lambda;
+    progress.lambda = field_penalty ? lambda : 0.0;
+    progress.bins = bins;
+    progress.evaluations += optimizer->numEvaluations();
+    return done;
 }
 
+
 void GlobalPlacer::plotPlacementResult(const string outfilename, bool isPrompt) {
     ofstream outfile(outfilename.c_str(), ios::out);
     outfile << " " << endl;
@@ -3,21 +3,119 @@
 #define GLOBALPLACER_H
 
 #include "Placement.h"
+#include "FlatNetlist.h"
+#include "ObjectiveFunction.h"
+#include "Optimizer.h"
+#include "TraceWriter.h"
 #include <cstdlib>
 #include <cstdio>
 #include <fstream>
+#include <optional>
+#include <random>
+
+/**
+ * @brief Density model of the analytical placer
+ */
+enum DensityModel {
+    DENSITY_BELL,           // Bell-shaped potential with Gaussian smoothing, field penalty (Density)
+    DENSITY_BELL_EXACT,     // Bell-shaped utilization with Gaussian smoothing, squared overflow (Density)
+    DENSITY_ELECTROSTATIC   // ePlace electrostatics solved with FFTs (ElectrostaticDensity)
+};
+
+/**
+ * @brief Optimizer of the analytical placer
+ */
+enum OptimizerType {
+    OPTIMIZER_CG,       // Polak-Ribiere conjugate gradient (SimpleConjugateGradient)
+    OPTIMIZER_NESTEROV, // Nesterov's method with the ePlace step prediction (NesterovOptimizer)
+    OPTIMIZER_LBFGS     // Limited-memory BFGS with the Armijo line search (LBFGSOptimizer)
+};
+
+/**
+ * @brief Global placement options set from the command line
+ */
+struct GlobalPlacerOptions
+{
+    // High-fanout nets in the wirelength model
+    HighFanoutMode hfMode = HF_EXACT;
+    size_t hfThreshold = 100;  // Nets with more pins are high-fanout nets, 0 disables
+    size_t hfPeriod = 10;      // Refresh period of HF_LAZY, in evaluations
+
+    // Incremental wirelength: recompute only the nets of modules that moved more than this
+    // distance since their last evaluation (negative disables)
+    double wlIncrementalTol = -1.0;
+
+    // Run the analytical placer in float32 instead of double
+    bool singlePrecision = false;
+
+    // Density model and bins per side of its grid (rounded up to a power of two for
+    // DENSITY_ELECTROSTATIC); 0 derives the grid size from the number of movable cells
+    DensityModel densityModel = DENSITY_BELL_EXACT;
+    int densityBins = 0;
+
+    // Global placement stops once the overflow (area above the target density over the
+    // movable area) drops to this fraction
+    double targetOverflow = 0.1;
+
+    // Coarse-to-fine grids: start at 32 bins per side and double the resolution whenever the
+    // density stops improving, up to densityBins
+    bool multiLevel = false;
+
+    // Optimizer, and the step-size rule of the conjugate gradient optimizer; unset picks
+    // STEP_NORM for the field penalty of DENSITY_BELL and STEP_ARMIJO otherwise
+    OptimizerType optimizer = OPTIMIZER_CG;
+    size_t lbfgsHistory = 8;  // Curvature pairs kept by OPTIMIZER_LBFGS
+    std::optional<StepSizeRule> stepSize;
+
+    // Scale every module's gradient by 1 / max(1, nets + lambda * area) (JacobiPreconditioner)
+    bool precondition = false;
+
+    // Project every module into the placement region after each optimizer step (BoxConstraint)
+    bool boxConstraint = true;
+
+    // Binary trace of the optimizer positions and gradients, written every traceEvery steps
+    // by a background thread (empty disables); bin/trace2txt converts it to text
+    string traceFile;
+    size_t traceEvery = 1;
+
+    // Density map and cell distribution plots in plot_output/, every plotEvery iterations
+    // (0 disables)
+    size_t plotEvery = 1;
+
+    // Seed of the random initial placement; negative draws one from std::random_device
+    long seed = -1;
+};
 
 class GlobalPlacer 
 {
 public:
-    GlobalPlacer(Placement &placement);
+    GlobalPlacer(Placement &placement, const GlobalPlacerOptions &options = GlobalPlacerOptions());
 	void place(bool rand_place);
     void plotPlacementResult( const string outfilename, bool isPrompt = false );
 
 private:
     Placement& _placement;
+    GlobalPlacerOptions _options;
     void plotBoxPLT( ofstream& stream, double x1, double y1, double x2, double y2 );
 
+    // State of the global placement loop carried from one density grid to the next
+    struct PlacementProgress {
+        int iteration = 0;    // Iterations run so far, over all grids
+        double growth = 1.0;  // Density weight of the next iteration over the balanced weight
+        double lambda = 0.0;  // Density weight of the next iteration of the field penalty, 0 before the first grid
+        int bins = 0;         // Bins of the grid the field penalty ran on last
+        size_t evaluations = 0;  // Objective evaluations so far, over all grids
+        TraceWriter *trace = nullptr;  // Trace of the optimizer steps, null if tracing is off
+    };
+
+    int autoBinCount(const FlatNetlist &netlist) const;
+
+    template <typename T>
+    void placeAnalytical(std::mt19937 &gen);
+    template <typename T, typename DensityFunction>
+    bool runGlobalPlacement(std::vector<Point2<T>> &t, const FlatNetlist &netlist, Wirelength<T> &wirelength_, DensityFunction &density_,
+                            JacobiPreconditioner<T> *precond, const BoxConstraint<T> &box, PlacementProgress &progress, bool final_grid);
+
 
 
 
@@ -1,5 +1,8 @@
 #include "ObjectiveFunction.h"
+#include "FastExp.h"
 #include "cstdio"
+#include <chrono>
+#include <map>
 using namespace std;
 
 // example function
@@ -34,627 +37,1217 @@ const std::vector<Point2<double>> &ExampleFunction::Backward()
 
 
 
-Wirelength::Wirelength(Placement &placement, double gamma)
-    : BaseFunction(placement.numModules()), placement_(placement), gamma_(gamma) {}
+template <typename T>
+Wirelength<T>::Wirelength(const FlatNetlist &netlist, double gamma)
+    : BaseFunction<T>(netlist.numModules()), netlist_(netlist), gamma_(gamma),
+      net_value_(netlist.numNets(), 0.0), pin_grad_(netlist.numPins(), Point2<T>(0.0, 0.0)) {
+    max_block_pins_ = kExpBatchPins;
+    for (size_t netId = 0; netId < netlist_.numNets(); ++netId) {
+        max_block_pins_ = std::max(max_block_pins_, netlist_.netDegree(netId));
+    }
+    scratch_.emplace_back(max_block_pins_);
+    buildBuckets();
+}
 
 
+template <typename T>
+Wirelength<T>::Scratch::Scratch(size_t max_pins)
+    : x(max_pins), y(max_pins), e(4 * max_pins), gx(max_pins), gy(max_pins), offsets(max_pins + 1) {}
 
-const double &Wirelength::operator()(const std::vector<Point2<double>> &input) {
-    value_ = 0.0; // the current value of the function, initialize to 0
-    input_ = input; // cache the input for backward pass
 
-    for (size_t netId = 0; netId < placement_.numNets(); ++netId) {
-        Net &net = placement_.net(netId);
-        const size_t pinCount = net.numPins();
-        if (pinCount == 0) continue;
+template <typename T>
+void Wirelength<T>::setThreadPool(ThreadPool *pool) {
+    pool_ = pool;
+    const size_t num_threads = pool ? pool->numThreads() : 1;
+    while (scratch_.size() < num_threads) scratch_.emplace_back(max_block_pins_);
+}
 
-        std::vector<double> x, y;
-        for (size_t k = 0; k < pinCount; ++k) {
-            Pin &pin = net.pin(k);
-            int moduleId = pin.moduleId();
-            if (placement_.module(moduleId).isFixed()) {
-                x.push_back(pin.x());
-                y.push_back(pin.y());
-            } else {
-                x.push_back(input[moduleId].x + (pin.x() - placement_.module(moduleId).centerX()));
-                y.push_back(input[moduleId].y + (pin.y() - placement_.module(moduleId).centerY()));
-            }
+
+template <typename T>
+void Wirelength<T>::buildBuckets() {
+    // Nets with fewer than two pins have zero wirelength and zero gradient, so they are left
+    // out and keep their zero slots.
+    for (auto &nets : degree_nets_) nets.clear();
+    large_nets_.clear();
+    hf_nets_.clear();
+    hf_stats_ = HighFanoutStats();
+
+    for (size_t netId = 0; netId < netlist_.numNets(); ++netId) {
+        const size_t degree = netlist_.netDegree(netId);
+        if (degree < 2) continue;
+        if (hf_threshold_ > 0 && degree > hf_threshold_) {
+            hf_nets_.push_back(netId);
+            hf_stats_.num_pins += degree;
+        } else if (degree <= kMaxSpecializedDegree) {
+            degree_nets_[degree].push_back(netId);
+        } else {
+            large_nets_.push_back(netId);
         }
+    }
+    hf_stats_.num_nets = hf_nets_.size();
 
-        auto wa = [&](const vector<double> &coord, double sign) {
-            double max_coord = *max_element(coord.begin(), coord.end());
-            double min_coord = *min_element(coord.begin(), coord.end());
-            double sum_exp = 0.0, sum_pos = 0.0;
-            double e = 0.0;
-            for (auto c : coord) {
-                if(sign == 1) 
-                {
-                    e = exp(sign * (c - max_coord) / gamma_);
-                }
-                else
-                {
-                    e = exp(sign * (c - min_coord) / gamma_);
+    // Start every high-fanout net from a clean slot, which is what HF_SKIP relies on
+    for (size_t netId : hf_nets_) {
+        net_value_[netId] = 0.0;
+        for (size_t p = netlist_.netBegin(netId); p < netlist_.netEnd(netId); ++p) {
+            pin_grad_[p] = Point2<T>(0.0, 0.0);
+        }
+    }
+}
 
-                }
-                
-                sum_exp += e;
-                sum_pos += c * e;
-            }
-            return sum_pos / sum_exp;
-        };
 
-        double wx = wa(x, 1.0) - wa(x, -1.0);
-        double wy = wa(y, 1.0) - wa(y, -1.0);
-        value_ += wx + wy;
-        // cout << "Wirelength for net " << netId << ": " << wx + wy << endl;
-    }
+template <typename T>
+void Wirelength<T>::setHighFanout(HighFanoutMode mode, size_t threshold, size_t period) {
+    hf_mode_ = mode;
+    hf_threshold_ = threshold;
+    hf_period_ = std::max<size_t>(1, period);
+    buildBuckets();
+}
 
+
+template <typename T>
+void Wirelength<T>::reportHighFanoutStats() const {
+    static const char *kModeName[] = {"exact", "skip", "b2b", "lazy"};
+    if (hf_stats_.num_nets == 0) return;
+    printf("INFO: High-fanout nets (> %zu pins, mode %s): %zu nets, %zu pins, "
+           "recomputed in %zu of %zu evaluations, %.2f s of %.2f s wirelength time (%.1f%%)\n",
+           hf_threshold_, kModeName[hf_mode_], hf_stats_.num_nets, hf_stats_.num_pins,
+           hf_stats_.refreshes, hf_stats_.evaluations, hf_stats_.seconds, hf_stats_.total_seconds,
+           hf_stats_.total_seconds > 0 ? 100.0 * hf_stats_.seconds / hf_stats_.total_seconds : 0.0);
+}
+
+
+template <typename T>
+const double &Wirelength<T>::operator()(const std::vector<Point2<T>> &input) {
+    input_ = &input; // keep a view of the input for the backward pass
+    evaluate(input, /*with_grad=*/false);
     return value_;
 }
 
 
-const std::vector<Point2<double>> &Wirelength::Backward() {
-    // Reset gradient vector
-    for (auto &g : grad_) {
-        g = Point2<double>(0.0, 0.0);
-    }
+template <typename T>
+const std::vector<Point2<T>> &Wirelength<T>::Backward() {
+    evaluate(*input_, /*with_grad=*/true);
+    return grad_;
+}
 
-    for (size_t netId = 0; netId < placement_.numNets(); ++netId) {
-        Net &net = placement_.net(netId);
-        size_t pinCount = net.numPins();
-        if (pinCount == 0) continue;
 
-        std::vector<double> x(pinCount), y(pinCount);
-        std::vector<int> moduleIds(pinCount);
-        std::vector<bool> isFixed(pinCount);
+template <typename T>
+const double &Wirelength<T>::ForwardBackward(const std::vector<Point2<T>> &input) {
+    input_ = &input;
+    evaluate(input, /*with_grad=*/true);
+    return value_;
+}
 
-        // Step 1: Collect pin positions (as in operator())
-        for (size_t k = 0; k < pinCount; ++k) {
-            Pin &pin = net.pin(k);
-            int moduleId = pin.moduleId();
-            moduleIds[k] = moduleId;
 
-            if (placement_.module(moduleId).isFixed()) {
-                x[k] = pin.x();
-                y[k] = pin.y();
-                isFixed[k] = true;
-            } else {
-                isFixed[k] = false;
-                double dx = pin.x() - placement_.module(moduleId).centerX();
-                double dy = pin.y() - placement_.module(moduleId).centerY();
-                x[k] = input_[moduleId].x + dx;
-                y[k] = input_[moduleId].y + dy;
+/**
+ * @details Computes the WA wirelength of every net and, when with_grad is set, the
+ * gradient in the same traversal, so the pin coordinates are gathered and the
+ * exponentials are evaluated only once per pin and direction.
+ *
+ * Each degree bucket runs its own kernel (see evaluateNets()). Within a bucket, nets are
+ * split across the thread pool. Every net writes its value and the gradient contribution
+ * of each of its pins into its own slots, and the totals are then reduced in net order
+ * and, per module, in pin order. The result is therefore bit-identical for any number of
+ * threads.
+ *
+ * In incremental mode, the slots double as a cache. Only the nets of modules that moved
+ * are recomputed: their cached value and pin gradients are subtracted from value_ and
+ * grad_ first and the fresh ones are added afterwards. Periodic full evaluations rebuild
+ * the totals from scratch so that rounding in these updates cannot build up.
+ */
+template <typename T>
+template <typename Kernel>
+void Wirelength<T>::runBucket(const std::vector<size_t> &nets, Kernel kernel) {
+    if (pool_) {
+        pool_->parallelFor(0, nets.size(), [&](size_t lo, size_t hi, size_t thread) { kernel(lo, hi, scratch_[thread]); });
+    } else {
+        kernel(0, nets.size(), scratch_[0]);
+    }
+}
+
+
+template <typename T>
+void Wirelength<T>::evaluate(const std::vector<Point2<T>> &input, bool with_grad) {
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point start = Clock::now();
+
+    // In incremental mode the gradient is always kept up to date, and every
+    // incremental_refresh_-th call is a full evaluation that clears any rounding drift.
+    const bool incremental = incremental_tol_ >= 0.0;
+    const bool partial = incremental && cache_valid_ && incremental_stats_.evaluations % incremental_refresh_ != 0;
+    with_grad = with_grad || incremental;
+
+    // Step 1: Nets to evaluate in each bucket, all of them or only the dirty ones
+    const std::vector<size_t> *nets[kNumBuckets] = {&degree_nets_[2], &degree_nets_[3], &degree_nets_[4],
+                                                    &large_nets_, &hf_nets_};
+    bool hf_refresh = false;
+    switch (hf_mode_) {
+        case HF_EXACT:
+        case HF_B2B:
+            hf_refresh = true;
+            break;
+        case HF_SKIP:
+            break;
+        case HF_LAZY:
+            hf_refresh = hf_stats_.evaluations % hf_period_ == 0;
+            break;
+    }
+    if (!hf_refresh) nets[kHighFanoutBucket] = &no_nets_;
+
+    if (partial) {
+        markDirtyNets(input);
+        for (size_t b = 0; b < kNumBuckets; ++b) {
+            // A lazy refresh recomputes all high-fanout nets, dirty or not
+            if (b == kHighFanoutBucket && hf_mode_ == HF_LAZY) continue;
+            dirty_nets_[b].clear();
+            for (size_t netId : *nets[b]) {
+                if (net_dirty_[netId]) dirty_nets_[b].push_back(netId);
             }
+            nets[b] = &dirty_nets_[b];
         }
 
-        auto computeGrad = [&](const vector<double> &coord, bool isX) {
-            double max_coord = *max_element(coord.begin(), coord.end());
-            double min_coord = *min_element(coord.begin(), coord.end());
-
-            // WA max
-            vector<double> emax(pinCount), emax_sum_each(pinCount);
-            double sum_emax = 0, sum_x_emax = 0;
-            for (size_t i = 0; i < pinCount; ++i) {
-                emax[i] = exp((coord[i] - max_coord) / gamma_);
-                sum_emax += emax[i];
-                sum_x_emax += coord[i] * emax[i];
-            }
-            double wa_max = sum_x_emax / sum_emax;
-
-            // WA min
-            vector<double> emin(pinCount), emin_sum_each(pinCount);
-            double sum_emin = 0, sum_x_emin = 0;
-            for (size_t i = 0; i < pinCount; ++i) {
-                emin[i] = exp(-(coord[i] - min_coord) / gamma_);
-                sum_emin += emin[i];
-                sum_x_emin += coord[i] * emin[i];
+        // Take the cached contributions of the nets about to be recomputed out of the totals
+        for (size_t b = 0; b < kNumBuckets; ++b) {
+            for (size_t netId : *nets[b]) addNetToTotals(netId, -1.0);
+        }
+    }
+
+    // Step 2: Evaluate the selected nets of every bucket
+    runBucket(*nets[0], [&](size_t lo, size_t hi, Scratch &scratch) { evaluateNets<2>(*nets[0], lo, hi, input, with_grad, scratch); });
+    runBucket(*nets[1], [&](size_t lo, size_t hi, Scratch &scratch) { evaluateNets<3>(*nets[1], lo, hi, input, with_grad, scratch); });
+    runBucket(*nets[2], [&](size_t lo, size_t hi, Scratch &scratch) { evaluateNets<4>(*nets[2], lo, hi, input, with_grad, scratch); });
+    runBucket(*nets[3], [&](size_t lo, size_t hi, Scratch &scratch) { evaluateNets<0>(*nets[3], lo, hi, input, with_grad, scratch); });
+
+    // A lazy refresh always includes the gradient so that a later Backward() can reuse it
+    const Clock::time_point hf_start = Clock::now();
+    const std::vector<size_t> &hf_nets = *nets[kHighFanoutBucket];
+    const bool hf_with_grad = with_grad || hf_mode_ == HF_LAZY;
+    if (hf_mode_ == HF_B2B) {
+        runBucket(hf_nets, [&](size_t lo, size_t hi, Scratch &) { evaluateBoundToBound(hf_nets, lo, hi, input, hf_with_grad); });
+    } else {
+        runBucket(hf_nets, [&](size_t lo, size_t hi, Scratch &scratch) { evaluateNets<0>(hf_nets, lo, hi, input, hf_with_grad, scratch); });
+    }
+    const Clock::time_point hf_end = Clock::now();
+
+    if (!hf_nets_.empty()) {
+        ++hf_stats_.evaluations;
+        if (hf_refresh) ++hf_stats_.refreshes;
+        hf_stats_.seconds += std::chrono::duration<double>(hf_end - hf_start).count();
+    }
+
+    if (incremental) {
+        ++incremental_stats_.evaluations;
+        for (size_t b = 0; b < kNumBuckets; ++b) incremental_stats_.nets_evaluated += nets[b]->size();
+        incremental_stats_.nets_total += netlist_.numNets();
+    }
+
+    // Step 3: Totals
+    if (partial) {
+        // Add the fresh contributions back and start tracking from the current positions
+        for (size_t b = 0; b < kNumBuckets; ++b) {
+            for (size_t netId : *nets[b]) {
+                addNetToTotals(netId, 1.0);
+                net_dirty_[netId] = 0;
             }
-            double wa_min = sum_x_emin / sum_emin;
-
-            // Now compute derivative contribution for each pin
-            for (size_t i = 0; i < pinCount; ++i) {
-                int moduleId = moduleIds[i];
-                if (isFixed[i]) continue;
-
-                // Derivative of WA max
-                double d_wa_max = emax[i] / sum_emax * (1 + (coord[i] - wa_max) / gamma_);
-                // Derivative of WA min
-                double d_wa_min = -emin[i] / sum_emin * (1 + (wa_min - coord[i]) / gamma_);
-                double grad_val = d_wa_max + d_wa_min;
-
-                if (isX)
-                    grad_[moduleId].x += grad_val;
-                else
-                    grad_[moduleId].y += grad_val;
+        }
+        hf_stats_.total_seconds += std::chrono::duration<double>(Clock::now() - start).count();
+        return;
+    }
+
+    value_ = 0.0;
+    for (size_t netId = 0; netId < net_value_.size(); ++netId) {
+        value_ += net_value_[netId];
+    }
+
+    if (with_grad) {
+        // Gather the pin contributions of every movable module in pin order
+        auto gatherModules = [&](size_t module_lo, size_t module_hi) {
+            for (size_t i = module_lo; i < module_hi; ++i) {
+                Point2<double> g(0.0, 0.0);
+                for (size_t k = netlist_.modulePinBegin(i); k < netlist_.modulePinEnd(i); ++k) {
+                    const Point2<T> &pg = pin_grad_[netlist_.modulePin(k)];
+                    g.x += pg.x;
+                    g.y += pg.y;
+                }
+                grad_[i] = Point2<T>(g.x, g.y);
             }
         };
-
-        // Step 2: Compute gradients
-        computeGrad(x, true);  // x-direction
-        computeGrad(y, false); // y-direction
+        if (pool_) {
+            pool_->parallelFor(0, grad_.size(), gatherModules);
+        } else {
+            gatherModules(0, grad_.size());
+        }
     }
-    // cout << "Wirelength grad for module 0: " << grad_[0].x << ", " << grad_[0].y << std::endl;
 
-    return grad_;
+    if (incremental) {
+        last_input_ = input;
+        std::fill(net_dirty_.begin(), net_dirty_.end(), 0);
+        cache_valid_ = true;
+    }
+    hf_stats_.total_seconds += std::chrono::duration<double>(Clock::now() - start).count();
 }
 
 
-Density::Density(Placement &placement, int bin_rows, int bin_cols, double alpha, double target_density)
-    : BaseFunction(placement.numModules()), placement_(placement),
-      bin_rows_(bin_rows), bin_cols_(bin_cols), alpha_(alpha), target_density_(target_density)
-{
+/**
+ * @details A module is moved once it is more than incremental_tol_ away, in x or in y, from
+ * the position at which its nets were last evaluated. Every net of a moved module becomes
+ * dirty, and the module's reference position is reset to where it is now.
+ */
+template <typename T>
+void Wirelength<T>::markDirtyNets(const std::vector<Point2<T>> &input) {
+    for (size_t i = 0; i < input.size(); ++i) {
+        if (std::abs(input[i].x - last_input_[i].x) <= incremental_tol_ &&
+            std::abs(input[i].y - last_input_[i].y) <= incremental_tol_) {
+            continue;
+        }
+        last_input_[i] = input[i];
+        for (size_t k = netlist_.modulePinBegin(i); k < netlist_.modulePinEnd(i); ++k) {
+            net_dirty_[netlist_.pinNet(netlist_.modulePin(k))] = 1;
+        }
+    }
+}
 
-    chip_left_ = placement.boundryLeft();
-    chip_right_ = placement.boundryRight();
-    chip_bottom_ = placement.boundryBottom();
-    chip_top_ = placement.boundryTop();
 
-    bin_width_ = (chip_right_ - chip_left_) / bin_cols_;
-    bin_height_ = (chip_top_ - chip_bottom_) / bin_rows_;
+template <typename T>
+void Wirelength<T>::addNetToTotals(size_t netId, double sign) {
+    value_ += sign * net_value_[netId];
+    for (size_t p = netlist_.netBegin(netId); p < netlist_.netEnd(netId); ++p) {
+        const int moduleId = netlist_.pinModule(p);
+        if (moduleId == FlatNetlist::kFixed) continue;
+        grad_[moduleId].x += sign * pin_grad_[p].x;
+        grad_[moduleId].y += sign * pin_grad_[p].y;
+    }
+}
 
-    bin_capacity_ = bin_width_ * bin_height_ * target_density_;
 
-    // Initialize bin density grid
-    bin_density_.resize(bin_rows_, std::vector<double>(bin_cols_, 0.0));
+template <typename T>
+void Wirelength<T>::setIncremental(double tolerance, size_t refresh_period) {
+    incremental_tol_ = tolerance;
+    incremental_refresh_ = std::max<size_t>(1, refresh_period);
+    cache_valid_ = false;
+    incremental_stats_ = IncrementalStats();
+    net_dirty_.assign(tolerance >= 0.0 ? netlist_.numNets() : 0, 0);
 }
 
 
-double Density::sigmoid(double d, double lower, double upper) const {
-    double f = 1/(1 + exp(-alpha_ * (d - lower)));
-    f *= 1/(1 + exp(-alpha_ * (upper - d)));
-    return f;
+template <typename T>
+void Wirelength<T>::reportIncrementalStats() const {
+    if (incremental_tol_ < 0.0 || incremental_stats_.nets_total == 0) return;
+    printf("INFO: Incremental wirelength (tolerance %g, full refresh every %zu): "
+           "%zu of %zu net evaluations recomputed (%.1f%%) over %zu evaluations\n",
+           incremental_tol_, incremental_refresh_, incremental_stats_.nets_evaluated,
+           incremental_stats_.nets_total,
+           100.0 * incremental_stats_.nets_evaluated / incremental_stats_.nets_total,
+           incremental_stats_.evaluations);
 }
 
 
-double Density::sigmoid_derivative(double d, double lower, double upper) const {
-    // Debug prints
-    if (std::abs(d) > 1e6 || std::abs(lower) > 1e6 || std::abs(upper) > 1e6) {
-        cout << "Large input values: d=" << d << ", lower=" << lower << ", upper=" << upper << endl;
+namespace {
+
+/**
+ * @brief WA wirelength of one net in one direction
+ *
+ * coord holds the pin coordinates, emax[i] = exp((coord[i] - max) / gamma) and
+ * emin[i] = exp(-(coord[i] - min) / gamma). If grad is not null, the derivative with respect
+ * to each pin coordinate is written to grad[i]. D > 0 fixes the pin count at compile time so
+ * the loops unroll and stay in registers; D == 0 takes the pin count from n.
+ */
+template <int D>
+inline double waDirection(const double *coord, const double *emax, const double *emin, size_t n,
+                          double gamma, double *grad) {
+    const size_t count = D > 0 ? D : n;
+    double sum_emax = 0, sum_x_emax = 0;
+    double sum_emin = 0, sum_x_emin = 0;
+    for (size_t i = 0; i < count; ++i) {
+        sum_emax += emax[i];
+        sum_x_emax += coord[i] * emax[i];
+        sum_emin += emin[i];
+        sum_x_emin += coord[i] * emin[i];
+    }
+    double wa_max = sum_x_emax / sum_emax;
+    double wa_min = sum_x_emin / sum_emin;
+
+    if (grad) {
+        for (size_t i = 0; i < count; ++i) {
+            // Derivative of WA max
+            double d_wa_max = emax[i] / sum_emax * (1 + (coord[i] - wa_max) / gamma);
+            // Derivative of WA min
+            double d_wa_min = -emin[i] / sum_emin * (1 + (wa_min - coord[i]) / gamma);
+            grad[i] = d_wa_max + d_wa_min;
+        }
     }
+    return wa_max - wa_min;
+}
 
-    // Limit exponential arguments
-    double exp1 = std::min(std::max(-alpha_ * (d - lower), -500.0), 500.0);
-    double exp2 = std::min(std::max(-alpha_ * (upper - d), -500.0), 500.0);
+}  // namespace
+
+
+/**
+ * @details Evaluates nets[lo, hi) of one degree bucket. The nets are processed in blocks of
+ * about kExpBatchPins pins: the pin coordinates of a block are gathered into flat arrays,
+ * the exponent arguments of all its pins are laid out as
+ *      e = [ x max | x min | y max | y min ]
+ * and handed to the vectorized fastExp() in one call, then each net is reduced with
+ * waDirection<D>(). A block never exceeds max_block_pins_, the size of the scratch buffers.
+ */
+template <typename T>
+template <int D>
+void Wirelength<T>::evaluateNets(const std::vector<size_t> &nets, size_t lo, size_t hi,
+                              const std::vector<Point2<T>> &input, bool with_grad, Scratch &scratch) {
+    double *x = scratch.x.data(), *y = scratch.y.data(), *e = scratch.e.data();
+    double *gx = scratch.gx.data(), *gy = scratch.gy.data();
+    size_t *offsets = scratch.offsets.data();
+
+    size_t block_lo = lo;
+    while (block_lo < hi) {
+        // Step 1: Take nets until the block holds kExpBatchPins pins (at least one net)
+        size_t block_hi, num_pins;
+        if (D > 0) {
+            block_hi = std::min(hi, block_lo + std::max<size_t>(1, kExpBatchPins / D));
+            num_pins = (block_hi - block_lo) * D;
+        } else {
+            num_pins = 0;
+            block_hi = block_lo;
+            while (block_hi < hi && (block_hi == block_lo ||
+                                     num_pins + netlist_.netDegree(nets[block_hi]) <= kExpBatchPins)) {
+                offsets[block_hi - block_lo] = num_pins;
+                num_pins += netlist_.netDegree(nets[block_hi]);
+                ++block_hi;
+            }
+            offsets[block_hi - block_lo] = num_pins;
+        }
+        auto netOffset = [&](size_t j) { return D > 0 ? j * D : offsets[j]; };
+        auto netSize = [&](size_t j) { return D > 0 ? size_t(D) : offsets[j + 1] - offsets[j]; };
+
+        // Step 2: Collect pin positions and exponent arguments
+        double *exmax = e, *exmin = exmax + num_pins;
+        double *eymax = exmin + num_pins, *eymin = eymax + num_pins;
+        for (size_t j = 0; j < block_hi - block_lo; ++j) {
+            const size_t begin = netlist_.netBegin(nets[block_lo + j]);
+            const size_t off = netOffset(j), n = netSize(j);
+            double *px = x + off, *py = y + off;
+            for (size_t k = 0; k < n; ++k) {
+                px[k] = netlist_.pinX(begin + k, input);
+                py[k] = netlist_.pinY(begin + k, input);
+            }
+            double max_x = px[0], min_x = px[0], max_y = py[0], min_y = py[0];
+            for (size_t k = 1; k < n; ++k) {
+                max_x = std::max(max_x, px[k]);
+                min_x = std::min(min_x, px[k]);
+                max_y = std::max(max_y, py[k]);
+                min_y = std::min(min_y, py[k]);
+            }
+            for (size_t k = 0; k < n; ++k) {
+                exmax[off + k] = (px[k] - max_x) / gamma_;
+                exmin[off + k] = -(px[k] - min_x) / gamma_;
+                eymax[off + k] = (py[k] - max_y) / gamma_;
+                eymin[off + k] = -(py[k] - min_y) / gamma_;
+            }
+        }
+        fastExp(e, e, 4 * num_pins);
+
+        // Step 3: WA value and derivative contribution for each pin
+        for (size_t j = 0; j < block_hi - block_lo; ++j) {
+            const size_t netId = nets[block_lo + j];
+            const size_t off = netOffset(j), n = netSize(j);
+            double wx = waDirection<D>(x + off, exmax + off, exmin + off, n, gamma_,
+                                       with_grad ? gx + off : nullptr);
+            double wy = waDirection<D>(y + off, eymax + off, eymin + off, n, gamma_,
+                                       with_grad ? gy + off : nullptr);
+            net_value_[netId] = wx + wy;
+
+            if (with_grad) {
+                const size_t begin = netlist_.netBegin(netId);
+                for (size_t k = 0; k < n; ++k) {
+                    pin_grad_[begin + k] = Point2<T>(gx[off + k], gy[off + k]);
+                }
+            }
+        }
 
-    double term1_num = alpha_ * exp(exp1);
-    double term1_den1 = 1 + exp(exp2);
-    double term1_den2 = pow(1 + exp(exp1), 2);
-    
-    // Check for division by zero
-    if (term1_den1 < 1e-300 || term1_den2 < 1e-300) {
-        return 0.0;  // Return safe value
+        block_lo = block_hi;
     }
-    
-    double term1 = term1_num / (term1_den1 * term1_den2);
+}
 
-    double term2_num = alpha_ * exp(exp2);
-    double term2_den1 = 1 + exp(exp1);
-    double term2_den2 = pow(1 + exp(exp2), 2);
-    
-    if (term2_den1 < 1e-300 || term2_den2 < 1e-300) {
-        return 0.0;  // Return safe value
-    }
-    
-    double term2 = term2_num / (term2_den1 * term2_den2);
 
-    return term1 - term2;
+/**
+ * @details Bound-to-bound model: the net contributes its exact HPWL, and only the pins on
+ * the bounding box carry a gradient, +1 for the maximum and -1 for the minimum pin of each
+ * direction. No exponentials are evaluated.
+ */
+template <typename T>
+void Wirelength<T>::evaluateBoundToBound(const std::vector<size_t> &nets, size_t lo, size_t hi,
+                                      const std::vector<Point2<T>> &input, bool with_grad) {
+    for (size_t j = lo; j < hi; ++j) {
+        const size_t netId = nets[j];
+        const size_t begin = netlist_.netBegin(netId), end = netlist_.netEnd(netId);
+
+        size_t max_x = begin, min_x = begin, max_y = begin, min_y = begin;
+        for (size_t p = begin + 1; p < end; ++p) {
+            const double x = netlist_.pinX(p, input), y = netlist_.pinY(p, input);
+            if (x > netlist_.pinX(max_x, input)) max_x = p;
+            if (x < netlist_.pinX(min_x, input)) min_x = p;
+            if (y > netlist_.pinY(max_y, input)) max_y = p;
+            if (y < netlist_.pinY(min_y, input)) min_y = p;
+        }
+        net_value_[netId] = (netlist_.pinX(max_x, input) - netlist_.pinX(min_x, input)) +
+                            (netlist_.pinY(max_y, input) - netlist_.pinY(min_y, input));
+
+        if (with_grad) {
+            for (size_t p = begin; p < end; ++p) {
+                pin_grad_[p] = Point2<T>(0.0, 0.0);
+            }
+            pin_grad_[max_x].x += 1.0;
+            pin_grad_[min_x].x -= 1.0;
+            pin_grad_[max_y].y += 1.0;
+            pin_grad_[min_y].y -= 1.0;
+        }
+    }
 }
 
+namespace {
+
+/**
+ * @brief Add the fraction of every bin covered by the fixed modules to grid
+ *
+ * Bin (by, bx) spans [left + bx * bin_width, left + (bx + 1) * bin_width) horizontally and
+ * likewise vertically. Fixed modules may overlap each other, so the coverage is capped at 1.
+ */
+template <typename U>
+void addFixedCoverage(const FlatNetlist &netlist, BinGrid<U> &grid, double left, double bottom,
+                      double bin_width, double bin_height) {
+    const double bin_area = bin_width * bin_height;
+    for (const Rectangle &rect : netlist.fixedRectangles()) {
+        const int bx_min = std::max(0, (int)std::floor((rect.left() - left) / bin_width));
+        const int bx_max = std::min(grid.cols() - 1, (int)std::floor((rect.right() - left) / bin_width));
+        const int by_min = std::max(0, (int)std::floor((rect.bottom() - bottom) / bin_height));
+        const int by_max = std::min(grid.rows() - 1, (int)std::floor((rect.top() - bottom) / bin_height));
+        for (int by = by_min; by <= by_max; ++by) {
+            for (int bx = bx_min; bx <= bx_max; ++bx) {
+                const Rectangle bin(left + bx * bin_width, bottom + by * bin_height,
+                                    left + (bx + 1) * bin_width, bottom + (by + 1) * bin_height);
+                grid[by][bx] += Rectangle::overlapArea(rect, bin) / bin_area;
+            }
+        }
+    }
+    for (size_t b = 0; b < grid.size(); ++b) {
+        grid.data()[b] = std::min<U>(grid.data()[b], U(1));
+    }
+}
 
+}  // namespace
 
-double Density::bell_shaped_potential(double dx, double wv, double wb) {
-    dx = std::abs(dx);
-    double a = 4.0 / ((wv + 2 * wb) * (wv + 4 * wb));
-    double b = 2.0 / (wb * (wv + 4 * wb));
-    
-    if (dx <= (wv / 2.0 + wb))
-        return 1.0 - a * dx * dx;
-    else if (dx <= wv / 2.0 + 2 * wb)
-        return b * pow(dx - wv / 2.0 - 2 * wb, 2.0);
-    else
-        return 0.0;
-}
 
-vector<vector<double>> Density::generateGaussianKernel(int size, double sigma) {
-    vector<vector<double>> kernel(size, vector<double>(size));
-    double sum = 0.0;
-    int center = size / 2;
+template <typename T>
+Density<T>::Density(const FlatNetlist &netlist, int bin_rows, int bin_cols, double target_density)
+    : BaseFunction<T>(netlist.numModules()), netlist_(netlist),
+      bin_rows_(bin_rows), bin_cols_(bin_cols), target_density_(target_density),
+      arena_(kNumGrids * GridArena::bytes<T>(bin_rows, bin_cols) + GridArena::bytes<double>(1, bin_cols))
+{
 
-    for (int i = 0; i < size; ++i)
-        for (int j = 0; j < size; ++j) {
-            double x = i - center;
-            double y = j - center;
-            kernel[i][j] = exp(-(x*x + y*y) / (2 * sigma * sigma));
-            sum += kernel[i][j];
-        }
+    chip_left_ = netlist.boundryLeft();
+    chip_right_ = netlist.boundryRight();
+    chip_bottom_ = netlist.boundryBottom();
+    chip_top_ = netlist.boundryTop();
 
-    for (auto& row : kernel)
-        for (auto& val : row)
-            val /= sum;
+    bin_width_ = (chip_right_ - chip_left_) / bin_cols_;
+    bin_height_ = (chip_top_ - chip_bottom_) / bin_rows_;
 
-    return kernel;
-}
+    bin_capacity_ = bin_width_ * bin_height_ * target_density_;
 
-void Density::applyGaussianSmoothing(std::vector<std::vector<double>> &density, int size, double sigma) {
-    auto kernel = generateGaussianKernel(size, sigma);
-    std::vector<std::vector<double>> smoothed = density;
+    // Allocate every grid once; evaluations only overwrite them
+    fixed_utilization_ = arena_.allocate<T>(bin_rows_, bin_cols_);
+    fixed_potential_ = arena_.allocate<T>(bin_rows_, bin_cols_);
+    utilization_ = arena_.allocate<T>(bin_rows_, bin_cols_);
+    bin_density_ = arena_.allocate<T>(bin_rows_, bin_cols_);
+    smoothing_buffer_ = arena_.allocate<T>(bin_rows_, bin_cols_);
+    adjoint_ = arena_.allocate<T>(bin_rows_, bin_cols_);
+    smoothing_row_ = arena_.allocate<double>(1, bin_cols_);
+    row_overflow_.resize(bin_rows_);
+    row_max_.resize(bin_rows_);
+    bin_index_ = BinIndex(bin_rows_, bin_cols_, chip_left_, chip_bottom_, bin_width_, bin_height_);
+
+    // Shape table of the movable modules
+    std::map<double, int> width_ids, height_ids;
+    shape_x_.assign(netlist.numModules(), -1);
+    shape_y_.assign(netlist.numModules(), -1);
+    for (size_t i = 0; i < netlist.numModules(); ++i) {
+        if (netlist.isFixed(i)) continue;
+        auto x = width_ids.emplace(netlist.width(i), (int)shapes_x_.size());
+        if (x.second) shapes_x_.push_back(makeBellShape(netlist.width(i), bin_width_));
+        shape_x_[i] = x.first->second;
+        auto y = height_ids.emplace(netlist.height(i), (int)shapes_y_.size());
+        if (y.second) shapes_y_.push_back(makeBellShape(netlist.height(i), bin_height_));
+        shape_y_[i] = y.first->second;
+    }
 
-    int offset = size / 2;
-    for (int y = 0; y < bin_rows_; ++y) {
-        for (int x = 0; x < bin_cols_; ++x) {
-            double val = 0.0;
-            for (int i = 0; i < size; ++i)
-                for (int j = 0; j < size; ++j) {
-                    int ny = y + i - offset;
-                    int nx = x + j - offset;
-                    if (ny >= 0 && ny < bin_rows_ && nx >= 0 && nx < bin_cols_)
-                        val += density[ny][nx] * kernel[i][j];
-                }
-            smoothed[y][x] = val;
-        }
+    // A bin filled by fixed modules is exactly at the target utilization. For the potential,
+    // the movable modules put bellMass() of potential per unit of area on the grid on
+    // average; a fixed module puts the same potential per unit of area it covers.
+    double movable_mass = 0.0;
+    movable_area_ = 0.0;
+    for (size_t i = 0; i < netlist.numModules(); ++i) {
+        if (netlist.isFixed(i)) continue;
+        movable_area_ += netlist.area(i);
+        movable_mass += bellMass(shapes_x_[shape_x_[i]], bin_width_) * bellMass(shapes_y_[shape_y_[i]], bin_height_);
+    }
+    addFixedCoverage(netlist, fixed_utilization_, chip_left_, chip_bottom_, bin_width_, bin_height_);
+    const double scale = movable_area_ > 0 ? movable_mass / movable_area_ * bin_width_ * bin_height_ : 0.0;
+    for (size_t b = 0; b < fixed_utilization_.size(); ++b) {
+        fixed_potential_.data()[b] = fixed_utilization_.data()[b] * scale;
+        fixed_utilization_.data()[b] *= target_density_;
     }
-    density = smoothed;
 }
 
 
-double Density::bell_shaped_potential_derivative(double dx, double wv, double wb) {
-    double abs_dx = abs(dx);
-    double sign = (dx >= 0) ? 1.0 : -1.0;
-    double a = 4.0 / ((wv + 2 * wb) * (wv + 4 * wb));
-    double b = 2.0 / (wb * (wv + 4 * wb));
-
-    if (abs_dx <= wv / 2.0 + wb)
-        return -2 * a * dx;
-    else if (abs_dx <= wv / 2.0 + 2 * wb)
-        return 2 * b * (abs_dx - wv / 2.0 - 2 * wb) * sign;
-    else
-        return 0.0;
+template <typename T>
+typename Density<T>::BellShape Density<T>::makeBellShape(double wv, double wb) {
+    BellShape shape;
+    shape.a = 4.0 / ((wv + 2 * wb) * (wv + 4 * wb));
+    shape.b = 2.0 / (wb * (wv + 4 * wb));
+    shape.inner = wv / 2.0 + wb;
+    shape.outer = wv / 2.0 + 2 * wb;
+    return shape;
 }
 
 
+template <typename T>
+double Density<T>::bellValue(const BellShape &shape, double d) {
+    d = std::abs(d);
+    if (d <= shape.inner) return 1.0 - shape.a * d * d;
+    if (d <= shape.outer) return shape.b * (d - shape.outer) * (d - shape.outer);
+    return 0.0;
+}
 
-const double& Density::operator()(const std::vector<Point2<double>> &input) {
 
-    value_ = 0.0;
-    input_ = input;  
-    // Reset bin density grid
-    for (int i = 0; i < bin_rows_; ++i)
-        std::fill(bin_density_[i].begin(), bin_density_[i].end(), 0.0);
-
-    const int num_modules = placement_.numModules();
-    for(int i = 0; i < num_modules; ++i)
-    {
-        Module &mod = placement_.module(i);
-        if(mod.isFixed()) continue;
-
-        // some constants
-        const double mod_area = mod.area();
-        const double mod_center_x = input[i].x;
-        const double mod_center_y = input[i].y;
-        const double mod_h = mod.height();
-        const double mod_w = mod.width();
-
-        const double influence_coefficient = 2;
-        double influence_range_x = mod_w * influence_coefficient;
-        double influence_range_y = mod_h * influence_coefficient;
-        
-        // set up the affecting region for the cell
-        double x_min = mod_center_x - influence_range_x;
-        double x_max = mod_center_x + influence_range_x;
-        double y_min = mod_center_y - influence_range_y;
-        double y_max = mod_center_y + influence_range_y;
-
-        // map to specific grid(s)
-        int bin_x_min = max(0, (int)((x_min - chip_left_) / bin_width_));
-        int bin_x_max = min(bin_cols_ - 1, (int)((x_max - chip_left_) / (bin_width_)));
-        int bin_y_min = max(0, (int)((y_min - chip_bottom_) / (bin_height_)));
-        int bin_y_max = min(bin_rows_ - 1, (int)((y_max - chip_bottom_) / (bin_height_)));
-
-        // accumulate density by applying sigmoid function
-        // x axis
-        
-
-            for(int by = bin_y_min; by <= bin_y_max; ++by)
-            {
-                double bin_center_y = chip_bottom_ + (by + 0.5) * bin_height_;
-                double dy = bin_center_y - mod_center_y;
-                double sy = bell_shaped_potential(dy, mod_h, bin_height_);
-                for(int bx = bin_x_min; bx <= bin_x_max; ++bx)
-                {
-                    double bin_center_x = chip_left_ + (bx + 0.5) * bin_width_;
-                    double dx = bin_center_x - mod_center_x;
-                    double sx = bell_shaped_potential(dx, mod_w, bin_width_);
-
-                    double density_influence = sx * sy;
-                    bin_density_[by][bx] += density_influence;
-                }
-                
-            }
-        
-    }
-    applyGaussianSmoothing(bin_density_, 5, 2);
+template <typename T>
+double Density<T>::bellSlope(const BellShape &shape, double d) {
+    const double abs_d = std::abs(d);
+    if (abs_d <= shape.inner) return -2.0 * shape.a * d;
+    if (abs_d <= shape.outer) return 2.0 * shape.b * (abs_d - shape.outer) * (d >= 0 ? 1.0 : -1.0);
+    return 0.0;
+}
 
 
-    // calculate the value for the term density
-    // density term sum(D_b(x, y) - M_b)^2
-    // D_b, density for bin b
-    // M_b, max density for bin b
+/**
+ * @details The potential integrates to 2 * (r - a r^3 / 3 + b wb^3 / 3), r = inner, over
+ * its support; summed over bin centers this is the integral divided by wb.
+ */
+template <typename T>
+double Density<T>::bellMass(const BellShape &shape, double wb) {
+    const double r = shape.inner;
+    return 2.0 * (r - shape.a * r * r * r / 3.0 + shape.b * wb * wb * wb / 3.0) / wb;
+}
 
-    
-    
 
-    // Step 1: Normalize bin_density_ to [0, 1] range
-    double p_min = numeric_limits<double>::max();
-    double p_max = numeric_limits<double>::lowest();
+/**
+ * @details The 2D Gaussian kernel is the outer product of this 1D kernel with itself, so
+ * smoothing with it is a horizontal and a vertical 1D pass. The kernel is rebuilt only
+ * when size or sigma change.
+ */
+template <typename T>
+const vector<double> &Density<T>::generateGaussianKernel(int size, double sigma) {
+    if (size == kernel_size_ && sigma == kernel_sigma_) return gaussian_kernel_;
 
-    for (int by = 0; by < bin_rows_; ++by) {
-        for (int bx = 0; bx < bin_cols_; ++bx) {
-            double val = bin_density_[by][bx];
-            p_min = min(p_min, val);
-            p_max = max(p_max, val);
-        }
+    gaussian_kernel_.assign(size, 0.0);
+    double sum = 0.0;
+    int center = size / 2;
+    for (int i = 0; i < size; ++i) {
+        double x = i - center;
+        gaussian_kernel_[i] = exp(-(x * x) / (2 * sigma * sigma));
+        sum += gaussian_kernel_[i];
     }
+    for (auto &val : gaussian_kernel_)
+        val /= sum;
 
-    // Avoid divide-by-zero
-    double epsilon = 1e-8;
-    double range = max(p_max - p_min, epsilon);
-    norm_density.resize(bin_rows_, std::vector<double>(bin_cols_, 0.0));
-    p_prime_prime.resize(bin_rows_, std::vector<double>(bin_cols_, 0.0));
-    overflow_array.resize(bin_rows_, std::vector<double>(bin_cols_, 0.0));
-    density_term_array.resize(bin_rows_, std::vector<double>(bin_cols_, 0.0));
-
-    // Normalize to [0, 1]
-    // norm_density(bin_rows_, vector<double>(bin_cols_));
-    for (int by = 0; by < bin_rows_; ++by)
-        for (int bx = 0; bx < bin_cols_; ++bx)
-            norm_density[by][bx] = (bin_density_[by][bx] - p_min) / range;
-
-    // Step 2: Compute normalized average
-    double p_avg = 0.0;
-    for (int by = 0; by < bin_rows_; ++by)
-        for (int bx = 0; bx < bin_cols_; ++bx)
-            p_avg += norm_density[by][bx];
-    p_avg /= (bin_rows_ * bin_cols_);
-
-    // Step 3: Apply level smoothing to normalized density
-    delta_for_smoothing_ = 5.0;
-    value_ = 0.0;
+    kernel_size_ = size;
+    kernel_sigma_ = sigma;
+    return gaussian_kernel_;
+}
 
-    for (int by = 0; by < bin_rows_; ++by) {
-        for (int bx = 0; bx < bin_cols_; ++bx) {
-            double p = norm_density[by][bx];
-            double p_prime = 0.0;
-
-            if (p >= p_avg)
-                p_prime = p_avg + pow(p - p_avg, delta_for_smoothing_);
-            else
-                p_prime = p_avg - pow(p_avg - p, delta_for_smoothing_);
-
-            p_prime_prime[by][bx] = p_prime;
-            double overflow = (p_prime - target_density_);  // compare to target
-            overflow_array[by][bx] = overflow;
-            value_ += overflow * overflow;
-            density_term_array[by][bx] = overflow * overflow;
-            // cout << "norm_density[" << by << "][" << bx << "] = " << norm_density[by][bx] << ", p_prime = " << p_prime << ", overflow = " << overflow << endl;
+/**
+ * @details Two 1D passes, rows into smoothing_buffer_ and columns back into density. Outside
+ * the grid the density is mirrored at the edges (bin -1 reads bin 0, bin -2 bin 1), so no
+ * area is lost at the region boundary and the operator is symmetric: it is its own adjoint,
+ * which is what Backward() relies on. The interior of each pass runs without bounds checks;
+ * only the bins within size / 2 of an edge take the checked path.
+ */
+template <typename T>
+void Density<T>::applyGaussianSmoothing(BinGrid<T> &density, int size, double sigma) {
+    const vector<double> &kernel = generateGaussianKernel(size, sigma);
+    const int offset = size / 2;
+    auto mirror = [](int k, int n) {
+        if (k < 0) k = -k - 1;
+        if (k >= n) k = 2 * n - 1 - k;
+        return std::min(std::max(k, 0), n - 1);  // Grids narrower than the kernel
+    };
+
+    // Horizontal pass
+    const int x_lo = std::min(offset, bin_cols_), x_hi = std::max(x_lo, bin_cols_ - offset);
+    for (int y = 0; y < bin_rows_; ++y) {
+        const T *in = density[y];
+        T *out = smoothing_buffer_[y];
+        auto edge = [&](int x) {
+            double val = 0.0;
+            for (int j = 0; j < size; ++j) {
+                val += in[mirror(x + j - offset, bin_cols_)] * kernel[j];
+            }
+            out[x] = val;
+        };
+        for (int x = 0; x < x_lo; ++x) edge(x);
+        for (int x = x_lo; x < x_hi; ++x) {
+            const T *window = in + x - offset;
+            double val = 0.0;
+            for (int j = 0; j < size; ++j) val += window[j] * kernel[j];
+            out[x] = val;
         }
+        for (int x = x_hi; x < bin_cols_; ++x) edge(x);
     }
 
-    return value_ ;
+    // Vertical pass, a row at a time so that the inner loop runs along contiguous memory
+    double *acc = smoothing_row_.data();
+    for (int y = 0; y < bin_rows_; ++y) {
+        T *out = density[y];
+        std::fill(acc, acc + bin_cols_, 0.0);
+        for (int i = 0; i < size; ++i) {
+            const T *in = smoothing_buffer_[mirror(y + i - offset, bin_rows_)];
+            const double k = kernel[i];
+            for (int x = 0; x < bin_cols_; ++x) acc[x] += in[x] * k;
+        }
+        for (int x = 0; x < bin_cols_; ++x) out[x] = acc[x];
+    }
 }
 
 
+template <typename T>
+Point2<T> Density<T>::potentialCenter(const Point2<T> &pos) const {
+    return Clamp(pos, Point2<T>(chip_left_, chip_bottom_), Point2<T>(chip_right_, chip_top_));
+}
 
-const std::vector<Point2<double>> &Density::Backward() {
-    const size_t num_modules = placement_.numModules();
 
-    // Reset gradients
-    for (auto &g : grad_)
-        g = Point2<double>(0.0, 0.0);
+template <typename T>
+void Density<T>::scatterWindow(size_t i, const Point2<T> &pos, int &bin_x_min, int &bin_x_max, int &bin_y_min, int &bin_y_max) const {
+    // Support of the potential
+    double influence_range_x = shapes_x_[shape_x_[i]].outer;
+    double influence_range_y = shapes_y_[shape_y_[i]].outer;
 
+    // set up the affecting region for the cell
+    double x_min = pos.x - influence_range_x;
+    double x_max = pos.x + influence_range_x;
+    double y_min = pos.y - influence_range_y;
+    double y_max = pos.y + influence_range_y;
 
-    vector<vector<double>> normalized(bin_rows_, vector<double>(bin_cols_));
-    for (int y = 0; y < bin_rows_; ++y) {
-        for (int x = 0; x < bin_cols_; ++x) {
-            normalized[y][x] = norm_density[y][x] / target_density_;  // or target_density_
-        }
-    }
+    // map to specific grid(s)
+    bin_x_min = max(0, (int)((x_min - chip_left_) / bin_width_));
+    bin_x_max = min(bin_cols_ - 1, (int)((x_max - chip_left_) / (bin_width_)));
+    bin_y_min = max(0, (int)((y_min - chip_bottom_) / (bin_height_)));
+    bin_y_max = min(bin_rows_ - 1, (int)((y_max - chip_bottom_) / (bin_height_)));
+}
 
-    std::vector<std::vector<std::pair<double, double>>> grad_map(bin_rows_, std::vector<std::pair<double, double>>(bin_cols_));
 
-    for (int y = 1; y < bin_rows_ - 1; ++y) {
-        for (int x = 1; x < bin_cols_ - 1; ++x) {
-            double dx = (norm_density[y][x + 1] - norm_density[y][x - 1]) / (2.0 * bin_width_);
-            double dy = (norm_density[y + 1][x] - norm_density[y - 1][x]) / (2.0 * bin_height_);
-            grad_map[y][x] = {dx, dy};
-        }
-    }
-    
+/**
+ * @details The tiles are fixed bands of kTileRows bin rows, so which modules share a
+ * buffer, and the order in which their contributions are summed, depend only on the
+ * positions and never on the number of threads. The modules of a tile are a contiguous
+ * range of the bin index, which sorts them by bin, row by row.
+ */
+template <typename T>
+void Density<T>::buildTiles(const std::vector<Point2<T>> &input) {
+    const size_t num_tiles = (bin_rows_ + kTileRows - 1) / kTileRows;
+    const size_t num_modules = netlist_.numModules();
+    tiles_.resize(num_tiles);
+    windows_.resize(num_modules);
+
+    // Windows, and where the profiles of each module go
+    size_t x_size = 0, y_size = 0;
     for (size_t i = 0; i < num_modules; ++i) {
-        Module &mod = placement_.module(i);
-        if (mod.isFixed()) continue;
+        if (netlist_.isFixed(i)) continue;
+        Window &win = windows_[i];
+        scatterWindow(i, potentialCenter(input[i]), win.x_min, win.x_max, win.y_min, win.y_max);
+        win.x_offset = x_size;
+        win.y_offset = y_size;
+        x_size += std::max(0, win.x_max - win.x_min + 1);
+        y_size += std::max(0, win.y_max - win.y_min + 1);
+    }
+    profile_x_.resize(x_size);
+    slope_x_.resize(x_size);
+    profile_y_.resize(y_size);
+    slope_y_.resize(y_size);
 
-        double cx = input_[i].x;
-        double cy = input_[i].y;
-        double w = mod.width();
-        double h = mod.height();
-        double area = mod.area();
+    bin_index_.build(input, [&](size_t i) { return netlist_.isFixed(i); });
+}
 
-        double influence_range_x = w * 4.0;
-        double influence_range_y = h * 4.0;
 
-        double x_min = cx - influence_range_x / 2.0;
-        double x_max = cx + influence_range_x / 2.0;
-        double y_min = cy - influence_range_y / 2.0;
-        double y_max = cy + influence_range_y / 2.0;
+template <typename T>
+size_t Density<T>::tileBegin(size_t k) const {
+    return bin_index_.offset(std::min<size_t>(k * kTileRows, bin_rows_) * bin_cols_);
+}
 
-        int bin_x_min = std::max(1, (int)((x_min - chip_left_) / bin_width_));
-        int bin_x_max = std::min(bin_cols_ - 2, (int)((x_max - chip_left_) / bin_width_));
-        int bin_y_min = std::max(1, (int)((y_min - chip_bottom_) / bin_height_));
-        int bin_y_max = std::min(bin_rows_ - 2, (int)((y_max - chip_bottom_) / bin_height_));
 
-        for (int by = bin_y_min; by <= bin_y_max; ++by) {
-            double bin_center_y = chip_bottom_ + (by + 0.5) * bin_height_;
-            double dy = bin_center_y - cy;
-            double wy = bell_shaped_potential(dy, h, bin_height_);
-
-            for (int bx = bin_x_min; bx <= bin_x_max; ++bx) {
-                double bin_center_x = chip_left_ + (bx + 0.5) * bin_width_;
-                double dx = bin_center_x - cx;
-                double wx = bell_shaped_potential(dx, w, bin_width_);
+/**
+ * @details The potential of a module is separable, sx(bx) * sy(by), so the profiles along x
+ * and y and their derivatives with respect to the module center are computed once per
+ * window and kept for Backward(), together with the normalization of the window. Modules of
+ * different tiles write disjoint ranges of the profile arrays. Along an axis where the center
+ * of a module is clamped to the region, its potential does not move with it, so its slopes
+ * are zero there.
+ */
+template <typename T>
+void Density<T>::scatterTile(size_t k, const std::vector<Point2<T>> &input) {
+    Tile &tile = tiles_[k];
+
+    // Rows reached by the modules of the tile
+    tile.row_lo = bin_rows_;
+    tile.row_hi = -1;
+    const size_t first = tileBegin(k), last = tileBegin(k + 1);
+    for (size_t j = first; j < last; ++j) {
+        const Window &win = windows_[bin_index_.modules()[j]];
+        tile.row_lo = std::min(tile.row_lo, win.y_min);
+        tile.row_hi = std::max(tile.row_hi, win.y_max);
+    }
+    if (tile.row_lo > tile.row_hi) return;
+    const bool field = penalty_ == PENALTY_FIELD;
+    tile.utilization.assign(size_t(tile.row_hi - tile.row_lo + 1) * bin_cols_, T(0));
+    if (field) tile.potential.assign(tile.utilization.size(), T(0));
+    const double bin_area = bin_width_ * bin_height_;
+
+    for (size_t j = first; j < last; ++j) {
+        const size_t i = bin_index_.modules()[j];
+        Window &win = windows_[i];
+        const Point2<T> center = potentialCenter(input[i]);
+        const double mod_center_x = center.x;
+        const double mod_center_y = center.y;
+        const double free_x = center.x == input[i].x ? 1.0 : 0.0;
+        const double free_y = center.y == input[i].y ? 1.0 : 0.0;
+        const BellShape &shape_x = shapes_x_[shape_x_[i]];
+        const BellShape &shape_y = shapes_y_[shape_y_[i]];
+
+        T *sx = profile_x_.data() + win.x_offset - win.x_min;
+        T *dsx = slope_x_.data() + win.x_offset - win.x_min;
+        double sum_x = 0.0, slope_sum_x = 0.0;
+        for(int bx = win.x_min; bx <= win.x_max; ++bx)
+        {
+            double bin_center_x = chip_left_ + (bx + 0.5) * bin_width_;
+            double dx = bin_center_x - mod_center_x;
+            sx[bx] = bellValue(shape_x, dx);
+            dsx[bx] = -free_x * bellSlope(shape_x, dx);
+            sum_x += sx[bx];
+            slope_sum_x += dsx[bx];
+        }
 
-                double weight = wx * wy;
+        T *sy = profile_y_.data() + win.y_offset - win.y_min;
+        T *dsy = slope_y_.data() + win.y_offset - win.y_min;
+        double sum_y = 0.0, slope_sum_y = 0.0;
+        for(int by = win.y_min; by <= win.y_max; ++by)
+        {
+            double bin_center_y = chip_bottom_ + (by + 0.5) * bin_height_;
+            double dy = bin_center_y - mod_center_y;
+            sy[by] = bellValue(shape_y, dy);
+            dsy[by] = -free_y * bellSlope(shape_y, dy);
+            sum_y += sy[by];
+            slope_sum_y += dsy[by];
+        }
 
-                grad_[i].x += weight * grad_map[by][bx].first * area;
-                grad_[i].y += weight * grad_map[by][bx].second * area;
+        const double mass = sum_x * sum_y;
+        win.scale = mass > 0 ? netlist_.area(i) / (mass * bin_area) : 0.0;
+        win.log_slope_x = sum_x > 0 ? slope_sum_x / sum_x : 0.0;
+        win.log_slope_y = sum_y > 0 ? slope_sum_y / sum_y : 0.0;
+        for(int by = win.y_min; by <= win.y_max; ++by)
+        {
+            T *util = tile.utilization.data() + size_t(by - tile.row_lo) * bin_cols_;
+            const double row_scale = win.scale * sy[by];
+            for(int bx = win.x_min; bx <= win.x_max; ++bx)
+            {
+                util[bx] += row_scale * sx[bx];
+            }
+            if (!field) continue;
+            T *row = tile.potential.data() + size_t(by - tile.row_lo) * bin_cols_;
+            for(int bx = win.x_min; bx <= win.x_max; ++bx)
+            {
+                row[bx] += double(sx[bx]) * sy[by];
             }
         }
     }
-
-    return grad_;
 }
 
 
+template <typename T>
+const double& Density<T>::operator()(const std::vector<Point2<T>> &input) {
+
+    // Scatter the tiles in parallel, then add them to the fixed utilization (and potential)
+    // row by row in tile order, measuring the overflow of every row on the way
+    const bool field = penalty_ == PENALTY_FIELD;
+    buildTiles(input);
+    auto scatterTiles = [&](size_t lo, size_t hi) {
+        for (size_t k = lo; k < hi; ++k) scatterTile(k, input);
+    };
+    auto reduceRows = [&](size_t lo, size_t hi) {
+        for (size_t by = lo; by < hi; ++by) {
+            T *util = utilization_[by];
+            T *row = bin_density_[by];
+            std::copy(fixed_utilization_[by], fixed_utilization_[by] + bin_cols_, util);
+            if (field) std::copy(fixed_potential_[by], fixed_potential_[by] + bin_cols_, row);
+            for (const Tile &tile : tiles_) {
+                if ((int)by < tile.row_lo || (int)by > tile.row_hi) continue;
+                const size_t offset = size_t(by - tile.row_lo) * bin_cols_;
+                const T *src_util = tile.utilization.data() + offset;
+                for (int bx = 0; bx < bin_cols_; ++bx) {
+                    util[bx] += src_util[bx];
+                }
+                if (!field) continue;
+                const T *src = tile.potential.data() + offset;
+                for (int bx = 0; bx < bin_cols_; ++bx) {
+                    row[bx] += src[bx];
+                }
+            }
+            double row_overflow = 0.0, row_max = 0.0;
+            for (int bx = 0; bx < bin_cols_; ++bx) {
+                row_overflow += std::max(0.0, util[bx] - target_density_);
+                row_max = std::max<double>(row_max, util[bx]);
+            }
+            row_overflow_[by] = row_overflow;
+            row_max_[by] = row_max;
+        }
+    };
+    if (pool_) {
+        pool_->parallelFor(0, tiles_.size(), scatterTiles);
+        pool_->parallelFor(0, bin_rows_, reduceRows);
+    } else {
+        scatterTiles(0, tiles_.size());
+        reduceRows(0, bin_rows_);
+    }
+    double overflow_area = 0.0;
+    max_utilization_ = 0.0;
+    for (int by = 0; by < bin_rows_; ++by) {
+        overflow_area += row_overflow_[by];
+        max_utilization_ = std::max(max_utilization_, row_max_[by]);
+    }
+    overflow_area *= bin_width_ * bin_height_;
+    overflow_ = movable_area_ > 0 ? overflow_area / movable_area_ : 0.0;
+
+    if (!field) {
+        // Smoothed utilization S and the squared overflow of its bins
+        std::copy(utilization_.data(), utilization_.data() + utilization_.size(), bin_density_.data());
+        applyGaussianSmoothing(bin_density_, 5, 2);
+        value_ = 0.0;
+        for (size_t b = 0; b < bin_density_.size(); ++b) {
+            const double excess = std::max(0.0, bin_density_.data()[b] - target_density_);
+            value_ += excess * excess;
+        }
+        return value_;
+    }
 
+    // Smoothed potential G P, normalized to phi in [0, 1]
+    applyGaussianSmoothing(bin_density_, 5, 2);
+    const T *smoothed = bin_density_.data();
+    const size_t num_bins = bin_density_.size();
+    const auto range = std::minmax_element(smoothed, smoothed + num_bins);
+    field_min_ = *range.first;
+    field_range_ = std::max<double>(*range.second - field_min_, 1e-8);
+    double phi_avg = 0.0;
+    for (size_t b = 0; b < num_bins; ++b) phi_avg += (smoothed[b] - field_min_) / field_range_;
+    phi_avg /= num_bins;
+
+    // Level smoothing of phi around its mean, then the squared distance to the target
+    constexpr double kLevelDelta = 5.0;
+    value_ = 0.0;
+    for (size_t b = 0; b < num_bins; ++b) {
+        const double phi = (smoothed[b] - field_min_) / field_range_;
+        const double level = phi >= phi_avg ? phi_avg + std::pow(phi - phi_avg, kLevelDelta)
+                                            : phi_avg - std::pow(phi_avg - phi, kLevelDelta);
+        value_ += (level - target_density_) * (level - target_density_);
+    }
+    return value_;
+}
 
-// const std::vector<Point2<double>> &Density::Backward() {
-//     const size_t num_modules = placement_.numModules();
-
-//     // Reset gradients
-//     for (auto &g : grad_)
-//         g = Point2<double>(0.0, 0.0);
 
 
-//     vector<vector<double>> normalized(bin_rows_, vector<double>(bin_cols_));
-//     for (int y = 0; y < bin_rows_; ++y) {
-//         for (int x = 0; x < bin_cols_; ++x) {
-//             normalized[y][x] = norm_density[y][x] / target_density_;  // or target_density_
-//         }
-//     }
+/**
+ * @details PENALTY_FIELD: the field G phi is sampled with the cached profiles,
+ *      grad_i = area_i * (sum_b (G phi)(b) dsx(bx) sy(by),  sum_b (G phi)(b) sx(bx) dsy(by)).
+ *
+ * PENALTY_OVERFLOW, by the chain rule through the three stages of the forward pass:
+ *  - d value / d S_b = 2 max(0, S_b - target);
+ *  - the smoothing is symmetric, so d value / d D is the same smoothing of that field, the
+ *    adjoint A;
+ *  - module i adds scale * sx(bx) sy(by) to D_b, with scale = area / (Sx Sy bin area), whose
+ *    derivative with respect to cx is scale * sy(by) (dsx(bx) - sx(bx) dSx / Sx).
+ * So, with R = sum_b A(b) sx(bx) sy(by),
+ *      d value / d cx = scale * (sum_b A(b) dsx(bx) sy(by) - R dSx / Sx)
+ * and likewise along y, all from the profiles cached by the forward pass. The normalization
+ * term keeps the area of a module constant while part of its potential leaves the region,
+ * so a module at the boundary is pushed back rather than out.
+ */
+template <typename T>
+const std::vector<Point2<T>> &Density<T>::Backward() {
+    const size_t num_modules = netlist_.numModules();
+    const bool field = penalty_ == PENALTY_FIELD;
+
+    // Step 1: the field, G phi, or d value / d D
+    for (size_t b = 0; b < bin_density_.size(); ++b) {
+        const double s = bin_density_.data()[b];
+        adjoint_.data()[b] = field ? (s - field_min_) / field_range_ : 2.0 * std::max(0.0, s - target_density_);
+    }
+    applyGaussianSmoothing(adjoint_, 5, 2);
+
+    // Step 2: every module only writes its own gradient, so the gather needs no synchronization
+    auto gatherModules = [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; ++i) {
+            if (netlist_.isFixed(i)) {
+                grad_[i] = Point2<T>(0.0, 0.0);
+                continue;
+            }
 
-//     std::vector<std::vector<std::pair<double, double>>> grad_map(bin_rows_, std::vector<std::pair<double, double>>(bin_cols_));
+            const Window &win = windows_[i];
+            const T *sx = profile_x_.data() + win.x_offset - win.x_min;
+            const T *dsx = slope_x_.data() + win.x_offset - win.x_min;
+            const T *sy = profile_y_.data() + win.y_offset - win.y_min;
+            const T *dsy = slope_y_.data() + win.y_offset - win.y_min;
+            double gx = 0.0, gy = 0.0, r = 0.0;  // Accumulated in double, stored as T
+
+            for (int by = win.y_min; by <= win.y_max; ++by) {
+                const T *row = adjoint_[by];
+                double row_x = 0.0, row_y = 0.0;
+                for (int bx = win.x_min; bx <= win.x_max; ++bx) {
+                    row_x += double(row[bx]) * dsx[bx];
+                    row_y += double(row[bx]) * sx[bx];
+                }
+                gx += row_x * sy[by];
+                gy += row_y * dsy[by];
+                r += row_y * sy[by];
+            }
+            if (field) {
+                grad_[i] = Point2<T>(gx * netlist_.area(i), gy * netlist_.area(i));
+            } else {
+                grad_[i] = Point2<T>(win.scale * (gx - r * win.log_slope_x), win.scale * (gy - r * win.log_slope_y));
+            }
+        }
+    };
 
+    if (pool_) {
+        pool_->parallelFor(0, num_modules, gatherModules);
+    } else {
+        gatherModules(0, num_modules);
+    }
 
-//     for (int by = 0; by < bin_rows_; ++by) {
-//         double bin_center_y = chip_bottom_ + (by + 0.5) * bin_height_;
-//         for (int bx = 0; bx < bin_cols_; ++bx) {
-//             double bin_center_x = chip_left_ + (bx + 0.5) * bin_width_;
+    return grad_;
+}
 
-//             double dL_dD = 2.0 * (norm_density[by][bx] - target_density_);  // assuming L2 loss
 
-//             for (size_t v = 0; v < placement_.numModules(); ++v) {
-//                 Module &mod = placement_.module(v);
-//                 if (mod.isFixed()) continue;
+template <typename T>
+ElectrostaticDensity<T>::ElectrostaticDensity(const FlatNetlist &netlist, int bin_rows, int bin_cols, double target_density)
+    : BaseFunction<T>(netlist.numModules()), netlist_(netlist),
+      bin_rows_(FFT::roundUp(std::max(1, bin_rows))), bin_cols_(FFT::roundUp(std::max(1, bin_cols))),
+      target_density_(target_density), fft_x_(bin_cols_), fft_y_(bin_rows_),
+      arena_(7 * GridArena::bytes<double>(bin_rows_, bin_cols_) + GridArena::bytes<double>(1, bin_rows_) +
+             GridArena::bytes<T>(bin_rows_, bin_cols_))
+{
+    chip_left_ = netlist.boundryLeft();
+    chip_right_ = netlist.boundryRight();
+    chip_bottom_ = netlist.boundryBottom();
+    chip_top_ = netlist.boundryTop();
+    const double chip_width = chip_right_ - chip_left_;
+    const double chip_height = chip_top_ - chip_bottom_;
+    bin_width_ = chip_width / bin_cols_;
+    bin_height_ = chip_height / bin_rows_;
+    bin_area_ = bin_width_ * bin_height_;
+
+    movable_area_ = 0.0;
+    for (size_t i = 0; i < netlist.numModules(); ++i) {
+        if (!netlist.isFixed(i)) movable_area_ += netlist.area(i);
+    }
 
-//                 double cx = input_[v].x;
-//                 double cy = input_[v].y;
-//                 double w = mod.width();
-//                 double h = mod.height();
+    freq_x_.resize(bin_cols_);
+    freq_y_.resize(bin_rows_);
+    for (int u = 0; u < bin_cols_; ++u) freq_x_[u] = M_PI * u / chip_width;
+    for (int v = 0; v < bin_rows_; ++v) freq_y_[v] = M_PI * v / chip_height;
+
+    fixed_rho_ = arena_.allocate<double>(bin_rows_, bin_cols_);
+    rho_ = arena_.allocate<double>(bin_rows_, bin_cols_);
+    coeff_ = arena_.allocate<double>(bin_rows_, bin_cols_);
+    psi_ = arena_.allocate<double>(bin_rows_, bin_cols_);
+    field_x_ = arena_.allocate<double>(bin_rows_, bin_cols_);
+    field_y_ = arena_.allocate<double>(bin_rows_, bin_cols_);
+    spectrum_ = arena_.allocate<double>(bin_rows_, bin_cols_);
+    column_ = arena_.allocate<double>(1, bin_rows_);
+    bin_density_ = arena_.allocate<T>(bin_rows_, bin_cols_);
+
+    addFixedCoverage(netlist, fixed_rho_, chip_left_, chip_bottom_, bin_width_, bin_height_);
+    for (size_t b = 0; b < fixed_rho_.size(); ++b) fixed_rho_.data()[b] *= target_density_;
+}
 
-//                 double dx = bin_center_x - cx;
-//                 double dy = bin_center_y - cy;
 
-//                 double Px = bell_shaped_potential(dx, w, bin_width_);
-//                 double dPx = bell_shaped_potential_derivative(dx, w, bin_width_);
+template <typename T>
+void ElectrostaticDensity<T>::transform1D(FFT &fft, Transform kind, double *data) {
+    switch (kind) {
+        case DCT:
+            fft.dct(data, data);
+            break;
+        case IDCT:
+            fft.idct(data, data);
+            break;
+        case IDST:
+            fft.idst(data, data);
+            break;
+    }
+}
 
-//                 double Py = bell_shaped_potential(dy, h, bin_height_);
-//                 double dPy = bell_shaped_potential_derivative(dy, h, bin_height_);
 
-//                 // Skip if the influence is 0
-//                 if (Px == 0 && Py == 0) continue;
+template <typename T>
+void ElectrostaticDensity<T>::transform2D(BinGrid<double> &grid, Transform along_x, Transform along_y) {
+    for (int by = 0; by < bin_rows_; ++by) {
+        transform1D(fft_x_, along_x, grid[by]);
+    }
+    double *column = column_.data();
+    for (int bx = 0; bx < bin_cols_; ++bx) {
+        for (int by = 0; by < bin_rows_; ++by) column[by] = grid[by][bx];
+        transform1D(fft_y_, along_y, column);
+        for (int by = 0; by < bin_rows_; ++by) grid[by][bx] = column[by];
+    }
+}
 
-//                 // Chain rule: ∂D/∂x = dPx * Py, ∂D/∂y = Px * dPy
-//                 grad_map[by][bx].first += dL_dD * dPx * Py;
-//                 grad_map[by][bx].second += dL_dD * Px * dPy;
-//             }
-//         }
-//     }
 
+/**
+ * @details The module is inflated to at least sqrt(2) bins in each direction and its charge
+ * density scaled by area / inflated area, then shifted so that the inflated module lies inside
+ * the region, so the charges passed to visit() always sum to the module area.
+ */
+template <typename T>
+template <typename Visitor>
+void ElectrostaticDensity<T>::forEachBin(size_t i, double cx, double cy, Visitor visit) const {
+    const double w = std::max(netlist_.width(i), M_SQRT2 * bin_width_);
+    const double h = std::max(netlist_.height(i), M_SQRT2 * bin_height_);
+    const double scale = netlist_.area(i) / (w * h);
+    cx = std::max(chip_left_ + w / 2, std::min(cx, chip_right_ - w / 2));
+    cy = std::max(chip_bottom_ + h / 2, std::min(cy, chip_top_ - h / 2));
+
+    const double x_lo = cx - w / 2 - chip_left_, x_hi = cx + w / 2 - chip_left_;
+    const double y_lo = cy - h / 2 - chip_bottom_, y_hi = cy + h / 2 - chip_bottom_;
+    const int bx_min = std::max(0, (int)std::floor(x_lo / bin_width_));
+    const int bx_max = std::min(bin_cols_ - 1, (int)std::floor(x_hi / bin_width_));
+    const int by_min = std::max(0, (int)std::floor(y_lo / bin_height_));
+    const int by_max = std::min(bin_rows_ - 1, (int)std::floor(y_hi / bin_height_));
+
+    for (int by = by_min; by <= by_max; ++by) {
+        const double oy = std::min(y_hi, (by + 1) * bin_height_) - std::max(y_lo, by * bin_height_);
+        if (oy <= 0) continue;
+        for (int bx = bx_min; bx <= bx_max; ++bx) {
+            const double ox = std::min(x_hi, (bx + 1) * bin_width_) - std::max(x_lo, bx * bin_width_);
+            if (ox <= 0) continue;
+            visit(size_t(by) * bin_cols_ + bx, scale * ox * oy);
+        }
+    }
+}
 
-//     vector<vector<pair<double, double>>> grad_map_norm(bin_rows_, vector<pair<double, double>>(bin_cols_));
 
-//     double px_min = numeric_limits<double>::max();
-//     double px_max = numeric_limits<double>::lowest();
-//     double py_min = numeric_limits<double>::max();
-//     double py_max = numeric_limits<double>::lowest();
-//     double epsilon = 1e-8;
+/**
+ * @details The density is expanded as
+ *      rho(x, y) = sum_uv a_uv cos(w_u x) cos(w_v y),
+ * with a_uv = c_u c_v / B * dct2(rho)_uv, c_0 = 1 and c_u = 2 otherwise. Then
+ *      psi(x, y) = sum_uv a_uv / (w_u^2 + w_v^2) cos(w_u x) cos(w_v y)
+ * solves the Poisson equation, with a_00 = 0 so that the potential has zero mean.
+ */
+template <typename T>
+const double &ElectrostaticDensity<T>::operator()(const std::vector<Point2<T>> &input) {
+    input_ = &input;
+
+    // Step 1: Charge density of the bins, on top of the fixed charges
+    std::copy(fixed_rho_.data(), fixed_rho_.data() + fixed_rho_.size(), rho_.data());
+    double *rho = rho_.data();
+    for (size_t i = 0; i < netlist_.numModules(); ++i) {
+        if (netlist_.isFixed(i)) continue;
+        forEachBin(i, input[i].x, input[i].y, [&](size_t b, double charge) { rho[b] += charge / bin_area_; });
+    }
 
-//     for (int by = 0; by < bin_rows_; ++by) {
-//         for (int bx = 0; bx < bin_cols_; ++bx) {
-//             double val1 = grad_map[by][bx].first;
-//             double val2 = grad_map[by][bx].second;
-//             px_min = min(px_min, val1);
-//             px_max = max(px_max, val1);
-//             py_min = min(py_min, val1);
-//             py_max = max(py_max, val1);
-//         }
-//     }
-//     double rangex = max(px_max - px_min, epsilon);
-//     double rangey = max(py_max - py_min, epsilon);
-    
+    double overflow_area = 0.0;
+    max_utilization_ = 0.0;
+    for (int by = 0; by < bin_rows_; ++by) {
+        for (int bx = 0; bx < bin_cols_; ++bx) {
+            const double d = rho_[by][bx];
+            bin_density_[by][bx] = d;
+            overflow_area += std::max(0.0, d - target_density_) * bin_area_;
+            max_utilization_ = std::max(max_utilization_, d);
+        }
+    }
+    overflow_ = movable_area_ > 0 ? overflow_area / movable_area_ : 0.0;
+
+    // Step 2: Cosine coefficients of the density
+    std::copy(rho_.data(), rho_.data() + rho_.size(), coeff_.data());
+    transform2D(coeff_, DCT, DCT);
+    const double norm = 1.0 / (double(bin_rows_) * bin_cols_);
+    for (int v = 0; v < bin_rows_; ++v) {
+        for (int u = 0; u < bin_cols_; ++u) {
+            coeff_[v][u] *= norm * (u == 0 ? 1.0 : 2.0) * (v == 0 ? 1.0 : 2.0);
+        }
+    }
+    coeff_[0][0] = 0.0;
 
-//     for (int by = 0; by < bin_rows_; ++by)
-//         for (int bx = 0; bx < bin_cols_; ++bx)
-//         {
-//             grad_map_norm[by][bx].first = (grad_map[by][bx].first - px_min) / rangex;
-//             grad_map_norm[by][bx].second = (grad_map[by][bx].second - py_min) / rangey;
+    // Step 3: Potential and energy
+    for (int v = 0; v < bin_rows_; ++v) {
+        for (int u = 0; u < bin_cols_; ++u) {
+            const double w2 = freq_x_[u] * freq_x_[u] + freq_y_[v] * freq_y_[v];
+            spectrum_[v][u] = u + v == 0 ? 0.0 : coeff_[v][u] / w2;
+        }
+    }
+    std::copy(spectrum_.data(), spectrum_.data() + spectrum_.size(), psi_.data());
+    transform2D(psi_, IDCT, IDCT);
 
-//         }
-    
-//     for (size_t i = 0; i < num_modules; ++i) {
-//         Module &mod = placement_.module(i);
-//         if (mod.isFixed()) continue;
+    value_ = 0.0;
+    for (size_t b = 0; b < rho_.size(); ++b) {
+        value_ += rho[b] * psi_.data()[b];
+    }
+    value_ *= 0.5 * bin_area_;
+    return value_;
+}
 
-//         double cx = input_[i].x;
-//         double cy = input_[i].y;
-//         double w = mod.width();
-//         double h = mod.height();
-//         double area = mod.area();
 
-//         double influence_range_x = w * 4.0;
-//         double influence_range_y = h * 4.0;
+/**
+ * @details The field -grad(psi) of the potential in operator() is
+ *      xi_x(x, y) = sum_uv a_uv w_u / (w_u^2 + w_v^2) sin(w_u x) cos(w_v y)
+ *      xi_y(x, y) = sum_uv a_uv w_v / (w_u^2 + w_v^2) cos(w_u x) sin(w_v y)
+ * and the gradient of the energy with respect to the position of a module is minus the
+ * charge-weighted sum of the field over the bins the module covers.
+ */
+template <typename T>
+const std::vector<Point2<T>> &ElectrostaticDensity<T>::Backward() {
+    for (int v = 0; v < bin_rows_; ++v) {
+        for (int u = 0; u < bin_cols_; ++u) {
+            const double w2 = freq_x_[u] * freq_x_[u] + freq_y_[v] * freq_y_[v];
+            field_x_[v][u] = u + v == 0 ? 0.0 : coeff_[v][u] * freq_x_[u] / w2;
+            field_y_[v][u] = u + v == 0 ? 0.0 : coeff_[v][u] * freq_y_[v] / w2;
+        }
+    }
+    transform2D(field_x_, IDST, IDCT);
+    transform2D(field_y_, IDCT, IDST);
+
+    const double *field_x = field_x_.data(), *field_y = field_y_.data();
+    for (size_t i = 0; i < netlist_.numModules(); ++i) {
+        if (netlist_.isFixed(i)) {
+            grad_[i] = Point2<T>(0.0, 0.0);
+            continue;
+        }
+        double gx = 0.0, gy = 0.0;
+        forEachBin(i, (*input_)[i].x, (*input_)[i].y, [&](size_t b, double charge) {
+            gx -= charge * field_x[b];
+            gy -= charge * field_y[b];
+        });
+        grad_[i] = Point2<T>(gx, gy);
+    }
+    return grad_;
+}
 
-//         double x_min = cx - influence_range_x / 2.0;
-//         double x_max = cx + influence_range_x / 2.0;
-//         double y_min = cy - influence_range_y / 2.0;
-//         double y_max = cy + influence_range_y / 2.0;
 
-//         int bin_x_min = std::max(1, (int)((x_min - chip_left_) / bin_width_));
-//         int bin_x_max = std::min(bin_cols_ - 2, (int)((x_max - chip_left_) / bin_width_));
-//         int bin_y_min = std::max(1, (int)((y_min - chip_bottom_) / bin_height_));
-//         int bin_y_max = std::min(bin_rows_ - 2, (int)((y_max - chip_bottom_) / bin_height_));
 
-//         for (int by = bin_y_min; by <= bin_y_max; ++by) {
-//             double bin_center_y = chip_bottom_ + (by + 0.5) * bin_height_;
-//             double dy = bin_center_y - cy;
-//             double wy = bell_shaped_potential(dy, h, bin_height_);
-
-//             for (int bx = bin_x_min; bx <= bin_x_max; ++bx) {
-//                 double bin_center_x = chip_left_ + (bx + 0.5) * bin_width_;
-//                 double dx = bin_center_x - cx;
-//                 double wx = bell_shaped_potential(dx, w, bin_width_);
-
-//                 double weight = wx * wy;
-
-//                 grad_[i].x += weight * grad_map_norm[by][bx].first * area;
-//                 grad_[i].y += weight * grad_map_norm[by][bx].second * area;
-//             }
-//         }
-//     }
-
-//     return grad_;
-// }
-
-
-
-ObjectiveFunction::ObjectiveFunction(Placement &placement, double lambda, Wirelength wirelength, Density density)
-    : BaseFunction(placement.numModules()),
+template <typename T>
+ObjectiveFunction<T>::ObjectiveFunction(Placement &placement, double lambda, Wirelength<T> &wirelength, BaseFunction<T> &density)
+    : BaseFunction<T>(placement.numModules()),
         wirelength_(wirelength),  // set γ as needed
         density_(density),                       // default: 50×50 grid
         lambda_(lambda)/*,
         grad_(placement.numModules(), Point2<double>(0.0, 0.0))*/ {}
 
-const double &ObjectiveFunction::operator()(const std::vector<Point2<double>> &input) {
-        input_ = input;                     // cache for Backward()
+template <typename T>
+const double &ObjectiveFunction<T>::operator()(const std::vector<Point2<T>> &input) {
         wirelength_(input);                // ensure internal input_ is set
         density_(input);                   // ensure internal input_ is set
         const double wl = wirelength_.value();
@@ -666,10 +1259,11 @@ const double &ObjectiveFunction::operator()(const std::vector<Point2<double>> &i
 
 
 
-const std::vector<Point2<double>> &ObjectiveFunction::Backward() {
-    // Store gradients in temporary vectors to prevent overwrites
-    auto grad_wl = wirelength_.Backward();  // Make a copy
-    auto grad_dp = density_.Backward();     // Make a copy
+template <typename T>
+const std::vector<Point2<T>> &ObjectiveFunction<T>::Backward() {
+    // Each term owns its gradient buffer, so both can be read in place
+    const std::vector<Point2<T>> &grad_wl = wirelength_.Backward();
+    const std::vector<Point2<T>> &grad_dp = density_.Backward();
 
     for (size_t i = 0; i < grad_.size(); ++i) {
         grad_[i].x = grad_wl[i].x + lambda_ * grad_dp[i].x;
@@ -681,10 +1275,50 @@ const std::vector<Point2<double>> &ObjectiveFunction::Backward() {
     return grad_;
 }
 
-void ObjectiveFunction::setLambda(double lambda) {
+template <typename T>
+const double &ObjectiveFunction<T>::ForwardBackward(const std::vector<Point2<T>> &input) {
+    // Each term computes its value and gradient together; combine them in place
+    const double wl = wirelength_.ForwardBackward(input);
+    const double dp = density_.ForwardBackward(input);
+    value_ = wl + lambda_ * dp;
+
+    const std::vector<Point2<T>> &grad_wl = wirelength_.grad();
+    const std::vector<Point2<T>> &grad_dp = density_.grad();
+    for (size_t i = 0; i < grad_.size(); ++i) {
+        grad_[i].x = grad_wl[i].x + lambda_ * grad_dp[i].x;
+        grad_[i].y = grad_wl[i].y + lambda_ * grad_dp[i].y;
+    }
+
+    return value_;
+}
+
+/**
+ * @details The terms keep the value and gradient of their last evaluation, so the combined
+ * value and gradient are rebuilt for the new lambda without evaluating anything. An optimizer
+ * that reuses its last evaluation in the next step thereby sees the current objective.
+ */
+template <typename T>
+void ObjectiveFunction<T>::setLambda(double lambda) {
     lambda_ = lambda;
+    value_ = wirelength_.value() + lambda_ * density_.value();
+    const std::vector<Point2<T>> &grad_wl = wirelength_.grad();
+    const std::vector<Point2<T>> &grad_dp = density_.grad();
+    for (size_t i = 0; i < grad_.size(); ++i) {
+        grad_[i].x = grad_wl[i].x + lambda_ * grad_dp[i].x;
+        grad_[i].y = grad_wl[i].y + lambda_ * grad_dp[i].y;
+    }
 }
 
-double ObjectiveFunction::getLambda() const {
+template <typename T>
+double ObjectiveFunction<T>::getLambda() const {
     return lambda_;
 }
+
+template class Wirelength<float>;
+template class Wirelength<double>;
+template class Density<float>;
+template class Density<double>;
+template class ElectrostaticDensity<float>;
+template class ElectrostaticDensity<double>;
+template class ObjectiveFunction<float>;
+template class ObjectiveFunction<double>;
@@ -4,12 +4,21 @@
 
 #include <vector>
 
+#include "BinGrid.h"
+#include "BinIndex.h"
+#include "FFT.h"
+#include "FlatNetlist.h"
 #include "Placement.h"
 #include "Point.h"
+#include "ThreadPool.h"
 
 /**
  * @brief Base class for objective functions
+ *
+ * @tparam T Floating-point type of the positions and gradients (float or double). The value is
+ *           always accumulated in double.
  */
+template <typename T>
 class BaseFunction {
    public:
     /////////////////////////////////
@@ -22,26 +31,39 @@ class BaseFunction {
     // Accessors
     /////////////////////////////////
 
-    const std::vector<Point2<double>> &grad() const { return grad_; }
+    const std::vector<Point2<T>> &grad() const { return grad_; }
     const double &value() const { return value_; }
 
+    // Exchange the gradient buffer with buffer (same size) in O(1). grad() then holds stale
+    // values until the next backward pass; only for functions whose backward pass overwrites
+    // every entry (e.g. ObjectiveFunction, not an incremental Wirelength)
+    void swapGrad(std::vector<Point2<T>> &buffer) { grad_.swap(buffer); }
+
     /////////////////////////////////
     // Methods
     /////////////////////////////////
 
     // Forward pass, compute the value of the function
-    virtual const double &operator()(const std::vector<Point2<double>> &input) = 0;
+    virtual const double &operator()(const std::vector<Point2<T>> &input) = 0;
 
     // Backward pass, compute the gradient of the function
-    virtual const std::vector<Point2<double>> &Backward() = 0;
+    virtual const std::vector<Point2<T>> &Backward() = 0;
+
+    // Fused forward and backward pass, compute both the value and the gradient
+    // Subclasses that can share work between the two passes should override this.
+    virtual const double &ForwardBackward(const std::vector<Point2<T>> &input) {
+        operator()(input);
+        Backward();
+        return value_;
+    }
 
    protected:
     /////////////////////////////////
     // Data members
     /////////////////////////////////
 
-    std::vector<Point2<double>> grad_;  // Gradient of the function
-    double value_;                      // Value of the function
+    std::vector<Point2<T>> grad_;  // Gradient of the function
+    double value_;                 // Value of the function
 };
 
 /**
@@ -50,7 +72,7 @@ class BaseFunction {
  * This is a simple example function for optimization. The function is defined as:
  *      f(t) = 3*t.x^2 + 2*t.x*t.y + 2*t.y^2 + 7
  */
-class ExampleFunction : public BaseFunction {
+class ExampleFunction : public BaseFunction<double> {
    public:
     /////////////////////////////////
     // Constructors
@@ -74,97 +96,386 @@ class ExampleFunction : public BaseFunction {
     Placement &placement_;
 };
 
+/**
+ * @brief How the wirelength model treats nets with more pins than the high-fanout threshold
+ */
+enum HighFanoutMode {
+    HF_EXACT,  // Full WA model, like any other net
+    HF_SKIP,   // Ignored: no wirelength and no gradient
+    HF_B2B,    // Bound-to-bound: exact HPWL, unit gradient on the extreme pins only
+    HF_LAZY    // Full WA model every hf_period evaluations, cached in between
+};
+
 /**
  * @brief Wirelength function
  */
 
-class Wirelength : public BaseFunction {
+template <typename T>
+class Wirelength : public BaseFunction<T> {
     public:
-        Wirelength(Placement &placement, double gamma);
-
-        const double &operator()(const std::vector<Point2<double>> &input) override;
-        const std::vector<Point2<double>> &Backward() override;
+        // Cost of the high-fanout nets, accumulated over all evaluations
+        struct HighFanoutStats {
+            size_t num_nets = 0;           // Nets above the threshold
+            size_t num_pins = 0;           // Pins on those nets
+            size_t evaluations = 0;        // Calls to the wirelength model
+            size_t refreshes = 0;          // Calls that recomputed the high-fanout nets
+            double seconds = 0.0;          // Time spent on the high-fanout nets
+            double total_seconds = 0.0;    // Time spent on all nets
+        };
+
+        // Work saved by the incremental mode, accumulated over all evaluations
+        struct IncrementalStats {
+            size_t evaluations = 0;        // Calls to the wirelength model
+            size_t nets_evaluated = 0;     // Nets recomputed, summed over the calls
+            size_t nets_total = 0;         // Nets in the netlist, summed over the calls
+        };
+
+        Wirelength(const FlatNetlist &netlist, double gamma);
+
+        const double &operator()(const std::vector<Point2<T>> &input) override;
+        const std::vector<Point2<T>> &Backward() override;
+        const double &ForwardBackward(const std::vector<Point2<T>> &input) override;
+
+        // Evaluate the nets on this pool; nullptr runs single-threaded. Allocates the scratch
+        // buffers of the pool's threads.
+        void setThreadPool(ThreadPool *pool);
+
+        // Treat nets with more than threshold pins according to mode (threshold 0 disables)
+        void setHighFanout(HighFanoutMode mode, size_t threshold, size_t period = 1);
+        const HighFanoutStats &highFanoutStats() const { return hf_stats_; }
+        void reportHighFanoutStats() const;
+
+        // Only recompute the nets of modules that moved more than tolerance since their nets
+        // were last evaluated, with a full evaluation every refresh_period calls. A negative
+        // tolerance disables the incremental mode.
+        void setIncremental(double tolerance, size_t refresh_period = 50);
+        const IncrementalStats &incrementalStats() const { return incremental_stats_; }
+        void reportIncrementalStats() const;
 
     private:
-        Placement &placement_;
+        static constexpr size_t kExpBatchPins = 1024;      // Pins per batched exp call
+        static constexpr size_t kMaxSpecializedDegree = 4;  // Largest degree with its own kernel
+        static constexpr size_t kNumBuckets = 5;            // Degree 2, 3, 4, large, high-fanout
+        static constexpr size_t kHighFanoutBucket = 4;
+
+        // Block buffers of evaluateNets(), one per thread, allocated once for the largest block
+        struct Scratch {
+            std::vector<double> x, y;     // Pin coordinates
+            std::vector<double> e;        // Exponent arguments, four per pin
+            std::vector<double> gx, gy;   // Pin gradients
+            std::vector<size_t> offsets;  // Start of each net of the block in x/y (D == 0 only)
+            explicit Scratch(size_t max_pins);
+        };
+
+        const FlatNetlist &netlist_;
         double gamma_;
-        std::vector<Point2<double>> input_;  // Cache input
+        ThreadPool *pool_ = nullptr;
+        size_t max_block_pins_;          // Largest block: kExpBatchPins, or one larger net
+        std::vector<Scratch> scratch_;   // Indexed by thread
+        const std::vector<Point2<T>> *input_ = nullptr;  // Input of the last forward pass (a view)
+
+        std::vector<double> net_value_;            // WA wirelength of each net
+        std::vector<Point2<T>> pin_grad_;     // Gradient contribution of each pin
+
+        // Nets by degree: degree_nets_[d] for 2 <= d <= kMaxSpecializedDegree, larger ones in
+        // large_nets_, and those above the high-fanout threshold in hf_nets_
+        std::vector<size_t> degree_nets_[kMaxSpecializedDegree + 1];
+        std::vector<size_t> large_nets_;
+        std::vector<size_t> hf_nets_;
+
+        HighFanoutMode hf_mode_ = HF_EXACT;
+        size_t hf_threshold_ = 0;
+        size_t hf_period_ = 1;
+        HighFanoutStats hf_stats_;
+        const std::vector<size_t> no_nets_;
+
+        double incremental_tol_ = -1.0;
+        size_t incremental_refresh_ = 50;
+        bool cache_valid_ = false;                 // net_value_/pin_grad_ and the totals match last_input_
+        std::vector<Point2<T>> last_input_;   // Position of each module when its nets were last evaluated
+        std::vector<char> net_dirty_;
+        std::vector<size_t> dirty_nets_[kNumBuckets];
+        IncrementalStats incremental_stats_;
+
+        // Sort the nets into the degree and high-fanout buckets
+        void buildBuckets();
+
+        // Walk all nets once, accumulate value_ and, if requested, grad_
+        void evaluate(const std::vector<Point2<T>> &input, bool with_grad);
+
+        // Mark the nets of every module that moved more than incremental_tol_
+        void markDirtyNets(const std::vector<Point2<T>> &input);
+
+        // Add sign times the cached value and pin gradients of a net to value_ and grad_
+        void addNetToTotals(size_t netId, double sign);
+
+        // Run kernel(lo, hi, scratch) over [0, nets.size()), split across the thread pool, with
+        // the scratch buffers of the thread running each chunk
+        template <typename Kernel>
+        void runBucket(const std::vector<size_t> &nets, Kernel kernel);
+
+        // Evaluate nets[lo, hi) of one bucket; D is the degree of the bucket, 0 for any degree
+        template <int D>
+        void evaluateNets(const std::vector<size_t> &nets, size_t lo, size_t hi,
+                          const std::vector<Point2<T>> &input, bool with_grad, Scratch &scratch);
+
+        // Bound-to-bound approximation of nets[lo, hi)
+        void evaluateBoundToBound(const std::vector<size_t> &nets, size_t lo, size_t hi,
+                                  const std::vector<Point2<T>> &input, bool with_grad);
+
+        using BaseFunction<T>::grad_;
+        using BaseFunction<T>::value_;
 };
 
 
 /**
- * @brief Density function
+ * @brief Penalty of the bell-shaped density
  */
+enum DensityPenalty {
+    PENALTY_FIELD,     // Modules pushed down the normalized potential field (default)
+    PENALTY_OVERFLOW   // Squared overflow of the smoothed utilization, with its exact gradient
+};
 
+/**
+ * @brief Bell-shaped density function (NTUPlace3)
+ *
+ * Every movable module spreads its area over the bins around it with the bell-shaped
+ * potential sx(bx) sy(by), normalized to sum to one over the bins of the region, so the
+ * utilization (module area over bin area) of bin b is
+ *      D_b = F_b + sum_i area_i sx_i(bx) sy_i(by) / (Sx_i Sy_i bin area),   Sx_i = sum_bx sx_i(bx),
+ * where F_b is the target times the fraction of the bin covered by fixed modules. The overflow
+ * and the peak utilization are measured on D. The value depends on the penalty:
+ *  - PENALTY_FIELD: the potential P_b = sum_i sx_i(bx) sy_i(by), plus that of the fixed
+ *    modules, is smoothed with a Gaussian kernel and normalized to [0, 1], phi = (G P - min) /
+ *    (max - min). The value is sum_b (phi'_b - target)^2 after level smoothing phi' of phi.
+ *    Backward() pushes every module down the smoothed field G phi, held fixed: module i gets
+ *    area_i times the derivative of sum_b (G phi)_b sx_i(bx) sy_i(by). This is not the
+ *    derivative of the value, which drops when bins below the target fill up and so would
+ *    pull modules together; it only suits fixed-norm steepest-descent steps.
+ *  - PENALTY_OVERFLOW: D is smoothed, S = G D, and the value is the squared overflow
+ *        sum_b max(0, S_b - target)^2.
+ *    Backward() returns its exact derivative.
+ * The potential of a module centered outside the region is centered at the nearest point of
+ * the region instead, so its area still lands in the edge bins and counts in the overflow.
+ */
+template <typename T>
+class Density : public BaseFunction<T> {
+    public:
+        Density(const FlatNetlist &netlist, int bin_rows = 50, int bin_cols = 50, double target_density = 0.9);
 
-// class Density : public BaseFunction {
-//     public:
-//         Density(Placement &placement, int bin_rows = 50, int bin_cols = 50, double sigma_factor = 1.5, double target_density = 0.9);
-
-//         const double &operator()(const std::vector<Point2<double>> &input) override;
-//         const std::vector<Point2<double>> &Backward() override;
-//         const double getBinCapacity() const { return bin_capacity_; }
-//         const std::vector<std::vector<double>> &getBinDensity() const { return bin_density_; }
-//     private:
-//         Placement &placement_;
 
-//         int bin_rows_, bin_cols_;
-//         double chip_left_, chip_right_, chip_top_, chip_bottom_;
-//         double bin_width_, bin_height_;
-//         double sigma_, sigma_sq_; // Gaussian smoothing σ and σ²
-//         double target_density_;
-//         double bin_capacity_;
+        
+        const double &operator()(const std::vector<Point2<T>> &input) override;
+        const std::vector<Point2<T>> &Backward() override;
 
-//         std::vector<std::vector<double>> bin_density_; // Smoothed density per bin
-//         std::vector<Point2<double>> input_;            // Cached module positions
-// };
+        const double getBinCapacity() const { return bin_capacity_; }
 
-class Density : public BaseFunction {
-    public:
-        Density(Placement &placement, int bin_rows = 50, int bin_cols = 50, double alpha = 10, double target_density = 0.9);
+        // Penalty of the value and gradient; takes effect at the next forward pass
+        void setPenalty(DensityPenalty penalty) { penalty_ = penalty; }
+        DensityPenalty getPenalty() const { return penalty_; }
 
+        // Smoothed potential G P (PENALTY_FIELD) or smoothed utilization S (PENALTY_OVERFLOW)
+        // of the last forward pass
+        const BinGrid<T> &getBinDensity() const { return bin_density_; }
 
-        
-        const double &operator()(const std::vector<Point2<double>> &input) override;
-        const std::vector<Point2<double>> &Backward() override;
+        // From the last forward pass: the area above the target utilization, summed over the
+        // bins, over the total movable area, and the largest bin utilization (module area over
+        // bin area). Fixed modules count as the target utilization times their coverage.
+        double getOverflow() const { return overflow_; }
+        double getMaxUtilization() const { return max_utilization_; }
 
-        const double getBinCapacity() const { return bin_capacity_; }
-        const std::vector<std::vector<double>> &getBinDensity() const { return bin_density_; }
+        // Movable modules by the bin of their center at the last forward pass, for queries of
+        // the cells in a bin or region in time proportional to its size
+        const BinIndex &getBinIndex() const { return bin_index_; }
 
-        // Optional: expose smoothing trigger
-        void smoothBinDensityLevel(int smoothing_pass = 1);
-        void setSmoothingDelta(double delta) { delta_for_smoothing_ = delta; }
-        double getSmoothingDelta()  { return delta_for_smoothing_; }
+        // Scatter and gather on this pool; nullptr runs single-threaded. The result does not
+        // depend on the number of threads.
+        void setThreadPool(ThreadPool *pool) { pool_ = pool; }
 
     private:
-        Placement &placement_;
+        // Movable modules whose center lies in a band of kTileRows bin rows, scattered into
+        // private utilization and (PENALTY_FIELD only) potential buffers that cover rows
+        // [row_lo, row_hi] of the grid
+        struct Tile {
+            int row_lo, row_hi;
+            std::vector<T> utilization;
+            std::vector<T> potential;
+        };
+        static constexpr int kTileRows = 8;
+
+        // Bell-shaped potential of one module size (width or height wv) over bins of size wb:
+        // 1 - a d^2 up to inner, b (|d| - outer)^2 up to outer, where d is the distance from
+        // the module center
+        struct BellShape {
+            double a, b;
+            double inner;  // wv / 2 + wb
+            double outer;  // wv / 2 + 2 wb, the support
+        };
+        static BellShape makeBellShape(double wv, double wb);
+        static double bellValue(const BellShape &shape, double d);
+        static double bellSlope(const BellShape &shape, double d);  // d potential / d d
+
+        // Potential of a module of size wv summed over the bins of size wb, per bin
+        static double bellMass(const BellShape &shape, double wb);
+
+        // Bins reached by the potential of a movable module. Its profile along x, sx and
+        // d sx / d cx for the bins [x_min, x_max], starts at x_offset; likewise along y.
+        // scale is area / (Sx Sy bin area), and log_slope_x is d log(Sx) / d cx.
+        struct Window {
+            int x_min, x_max, y_min, y_max;
+            size_t x_offset, y_offset;
+            double scale;
+            double log_slope_x, log_slope_y;
+        };
+
+        const FlatNetlist &netlist_;
+        ThreadPool *pool_ = nullptr;
+        DensityPenalty penalty_ = PENALTY_FIELD;
 
         int bin_rows_, bin_cols_;
         double chip_left_, chip_right_, chip_top_, chip_bottom_;
         double bin_width_, bin_height_;
-        double alpha_;                  // Alpha for sigmoid steepness
         double target_density_;
         double bin_capacity_;
-        double delta_for_smoothing_; // Delta for smoothing
+        double movable_area_;
+        double overflow_ = 0.0;
+        double max_utilization_ = 0.0;
+        double field_min_ = 0.0, field_range_ = 1.0;  // Normalization of G P (PENALTY_FIELD)
+
+        // All grids are allocated from arena_ at construction and reused by every evaluation
+        static constexpr int kNumGrids = 6;
+        GridArena arena_;
+        BinGrid<T> fixed_utilization_; // F, built once at construction
+        BinGrid<T> fixed_potential_;   // Potential of the fixed modules, built once at construction
+        BinGrid<T> utilization_;   // D, area of the modules in each bin over the bin area
+        BinGrid<T> bin_density_;   // G P or S, see getBinDensity()
+        BinGrid<T> smoothing_buffer_;  // Result of the horizontal smoothing pass
+        BinGrid<T> adjoint_;           // The field that Backward() samples
+        BinGrid<double> smoothing_row_;  // Row accumulator of the vertical pass (one row)
+
+        vector<double> gaussian_kernel_;      // Cached by generateGaussianKernel()
+        int kernel_size_ = 0;
+        double kernel_sigma_ = 0.0;
+
+        // Shape table built at construction: standard cells share a few widths and heights, so
+        // every distinct width and height gets its coefficients once
+        std::vector<BellShape> shapes_x_, shapes_y_;
+        std::vector<int> shape_x_, shape_y_;      // Shape of every module, -1 if fixed
+
+        // Windows and profiles of the movable modules from the last forward pass
+        std::vector<Window> windows_;
+        std::vector<T> profile_x_, slope_x_;
+        std::vector<T> profile_y_, slope_y_;
+
+        std::vector<Tile> tiles_;
+        BinIndex bin_index_;                      // Movable modules by the bin of their center
+        std::vector<double> row_overflow_;        // Overflow area and peak utilization of every bin row
+        std::vector<double> row_max_;
+
+        // Center of the potential of a module at pos: pos clamped into the region
+        Point2<T> potentialCenter(const Point2<T> &pos) const;
+
+        // Bins covered by the bell-shaped potential of module i centered at pos
+        void scatterWindow(size_t i, const Point2<T> &pos, int &bin_x_min, int &bin_x_max, int &bin_y_min, int &bin_y_max) const;
+
+        // Compute the windows of the movable modules and index them by the bin of their center
+        void buildTiles(const std::vector<Point2<T>> &input);
+
+        // Tile k holds bin_index_.modules()[tileBegin(k), tileBegin(k + 1))
+        size_t tileBegin(size_t k) const;
+
+        // Compute the profiles of the modules of tile k and add their utilization and
+        // potential to its buffers
+        void scatterTile(size_t k, const std::vector<Point2<T>> &input);
+
+        void applyGaussianSmoothing(BinGrid<T> &density, int size, double sigma); // size is the size of the kernel. sigma is the standard deviation of the Gaussian
+        const vector<double> &generateGaussianKernel(int size, double sigma);  // Normalized 1D kernel, cached
+
+        using BaseFunction<T>::grad_;
+        using BaseFunction<T>::value_;
+
+};
+
+
+/**
+ * @brief Electrostatic density function (ePlace)
+ *
+ * Every movable module is a positive charge equal to its area, spread over the bins it
+ * overlaps; a module reaching past the region is shifted inside it first, so that all of
+ * its charge counts. Fixed modules are charges that never move, scaled by the target density so
+ * that a bin filled by a macro is exactly at the target. Modules smaller than sqrt(2) bins are inflated to that size with their charge
+ * density scaled down, so that their charge does not fall between bin centers. The charge
+ * density rho of the bins is the source of Poisson's equation
+ *      -laplacian(psi) = rho,    with zero normal derivative on the region boundary,
+ * which is solved in the cosine basis of the grid with FFT-based DCTs in O(B log B) for B
+ * bins (the constant term, the mean density, is dropped). The value is the system energy
+ *      1/2 sum_b q_b psi_b
+ * and the gradient of a module is minus its charge times the electric field -grad(psi),
+ * sampled over the bins the module covers.
+ *
+ * Unlike Density, it keeps no BinIndex: its scatter and gather run over the modules in index
+ * order on one thread, and the Poisson solve dominates its cost, so nothing in it needs the
+ * modules grouped by bin. A caller that wants region queries on this model builds a BinIndex
+ * from the positions, in O(modules + bins).
+ */
+template <typename T>
+class ElectrostaticDensity : public BaseFunction<T> {
+    public:
+        // The bin counts are rounded up to powers of two for the FFT
+        ElectrostaticDensity(const FlatNetlist &netlist, int bin_rows = 256, int bin_cols = 256, double target_density = 0.9);
 
-        std::vector<std::vector<double>> bin_density_; // Smoothed density per bin
-        vector<vector<double>> norm_density;
-        vector<vector<double>> p_prime_prime;
-        vector<vector<double>> overflow_array;
-        vector<vector<double>> density_term_array;
+        const double &operator()(const std::vector<Point2<T>> &input) override;
+        const std::vector<Point2<T>> &Backward() override;
 
+        // Bin utilization (module area over bin area) of the last forward pass
+        const BinGrid<T> &getBinDensity() const { return bin_density_; }
 
-        std::vector<Point2<double>> input_;            // Cached module positions
+        // Area above the target density, summed over the bins, over the total movable area
+        double getOverflow() const { return overflow_; }
+        double getMaxUtilization() const { return max_utilization_; }
 
-        // Sigmoid function used for smoothing density influence
-        double sigmoid(double d, double lower, double upper) const;
-        double sigmoid_derivative(double d, double lowwer, double upper) const;
-        double bell_shaped_potential(double dx, double wv, double wb);
-        void applyGaussianSmoothing(vector<vector<double>> &density, int size, double sigma); // size is the size of the kernel. sigma is the standard deviation of the Gaussian
-        vector<vector<double>> generateGaussianKernel(int size, double sigma);
-        double bell_shaped_potential_derivative(double dx, double wv, double wb);
+    private:
+        enum Transform { DCT, IDCT, IDST };
 
+        const FlatNetlist &netlist_;
 
+        int bin_rows_, bin_cols_;
+        double chip_left_, chip_right_, chip_bottom_, chip_top_;
+        double bin_width_, bin_height_, bin_area_;
+        double target_density_;
+        double movable_area_;
+        double overflow_ = 0.0;
+        double max_utilization_ = 0.0;
+
+        FFT fft_x_;                     // Length bin_cols_
+        FFT fft_y_;                     // Length bin_rows_
+        std::vector<double> freq_x_;    // w_u = pi u / chip width
+        std::vector<double> freq_y_;    // w_v = pi v / chip height
+
+        // bin_rows_ x bin_cols_ grids, allocated from arena_ at construction
+        GridArena arena_;
+        BinGrid<double> fixed_rho_; // Charge density of the fixed modules, built once at construction
+        BinGrid<double> rho_;       // Charge density
+        BinGrid<double> coeff_;     // Cosine coefficients a_uv of rho_
+        BinGrid<double> psi_;       // Potential
+        BinGrid<double> field_x_;   // Electric field
+        BinGrid<double> field_y_;
+        BinGrid<double> spectrum_;  // Scratch for the coefficients of psi_
+        BinGrid<double> column_;    // Scratch column (one row of bin_rows_)
+        BinGrid<T> bin_density_;
+        const std::vector<Point2<T>> *input_ = nullptr;  // Input of the last forward pass (a view)
+
+        // Apply transform along x to every row and transform along y to every column, in place
+        void transform2D(BinGrid<double> &grid, Transform along_x, Transform along_y);
+        void transform1D(FFT &fft, Transform kind, double *data);
+
+        // Call visit(bin, charge) for every bin overlapped by module i centered at (cx, cy),
+        // shifted into the region
+        template <typename Visitor>
+        void forEachBin(size_t i, double cx, double cy, Visitor visit) const;
+
+        using BaseFunction<T>::grad_;
+        using BaseFunction<T>::value_;
 };
 
 
@@ -175,24 +486,30 @@ class Density : public BaseFunction {
  */
 
 
-class ObjectiveFunction : public BaseFunction {
+template <typename T>
+class ObjectiveFunction : public BaseFunction<T> {
     public:
-        ObjectiveFunction(Placement &placement, double lambda, Wirelength wirelength, Density density);
+        // The density term is any density function over the same modules, e.g. Density or
+        // ElectrostaticDensity. Both terms are held by reference and must outlive this object.
+        ObjectiveFunction(Placement &placement, double lambda, Wirelength<T> &wirelength, BaseFunction<T> &density);
 
-        const double &operator()(const std::vector<Point2<double>> &input) override;
-        const std::vector<Point2<double>> &Backward() override;
+        const double &operator()(const std::vector<Point2<T>> &input) override;
+        const std::vector<Point2<T>> &Backward() override;
+        const double &ForwardBackward(const std::vector<Point2<T>> &input) override;
 
-        void setLambda(double lambda);  // Optional: expose dynamic λ adjustment
+        void setLambda(double lambda);  // Also recombines the value and gradient of the last evaluation
         double getLambda() const;
-        const Wirelength &getWirelength() const { return wirelength_; }
-        const Density &getDensity() const { return density_; }
+        const Wirelength<T> &getWirelength() const { return wirelength_; }
+        const BaseFunction<T> &getDensity() const { return density_; }
 
     private:
-        Wirelength wirelength_;
-        Density density_;
+        Wirelength<T> &wirelength_;
+        BaseFunction<T> &density_;
         double lambda_;
         // std::vector<Point2<double>> grad_;  // Combined gradient cache
-        std::vector<Point2<double>> input_;            // Cached module positions
+
+        using BaseFunction<T>::grad_;
+        using BaseFunction<T>::value_;
     
 };
 
@@ -1,63 +1,184 @@
 #include "Optimizer.h"
 #include <iostream>
 #include <cmath>
-#include <fstream>   // for std::ofstream
 #include <vector>    // for std::vector
-#include <string>    // for std::string (if you use file paths with std::string)
+#include <algorithm>
+#include <limits>
 
-SimpleConjugateGradient::SimpleConjugateGradient(BaseFunction &obj,
-                                                 std::vector<Point2<double>> &var,
+/**
+ * @details Backtracking from var_ along dir until the Armijo condition
+ *     f(x + alpha d) <= f(x) + kArmijo * alpha * slope
+ * holds. The trials are forward passes only: a rejected trial's value f(alpha), together with
+ * f(x) = obj_.value() and the slope from the caller's gradient pass, fits a quadratic whose minimizer, kept
+ * within [0.1, 0.5] * alpha, is the next trial. If kMaxTrials trials all fail, var_ moves to
+ * the trial with the lowest value if that is below f(x), and back to the start otherwise, so
+ * no step increases the objective. The trials are placed by moveToTrial(), and a failed
+ * search swaps the start back in, so it leaves var_ bit for bit as it was.
+ */
+template <typename T>
+bool BaseOptimizer<T>::armijoSearch(const std::vector<Point2<T>> &dir, double slope, double &alpha) {
+    constexpr double kArmijo = 1e-4;
+    constexpr int kMaxTrials = 8;
+
+    const double f0 = obj_.value();
+    double best_f = f0, best_alpha = 0.0;  // Lowest trial so far, the start if none is lower
+    this->startSearch();
+    for (int trial = 1;; ++trial) {
+        moveToTrial(dir, alpha);
+        const double f = obj_(var_);
+        ++num_evaluations_;
+        if (f <= f0 + kArmijo * alpha * slope) return true;
+        if (f < best_f) {
+            best_f = f;
+            best_alpha = alpha;
+        }
+        if (trial == kMaxTrials) break;
+
+        const double curvature = f - f0 - slope * alpha;  // > 0 since the condition failed
+        const double next = -slope * alpha * alpha / (2.0 * curvature);
+        alpha = std::min(0.5 * alpha, std::max(0.1 * alpha, next));
+    }
+
+    if (best_alpha == 0.0) {
+        var_.swap(start_);
+        trial_projected_ = 0;
+        return false;
+    }
+    moveToTrial(dir, best_alpha);
+    alpha = best_alpha;
+    return true;
+}
+
+template <typename T>
+void BaseOptimizer<T>::moveToTrial(const std::vector<Point2<T>> &dir, double alpha) {
+    for (size_t i = 0; i < var_.size(); ++i) {
+        var_[i] = start_[i] + T(alpha) * dir[i];
+    }
+    trial_projected_ = project(var_);
+}
+
+/**
+ * @details A module with several pins on one net counts that net once.
+ */
+template <typename T>
+JacobiPreconditioner<T>::JacobiPreconditioner(const FlatNetlist &netlist)
+    : degree_(netlist.numModules(), 0.0), area_(netlist.numModules(), 0.0) {
+    std::vector<size_t> last_module(netlist.numNets(), netlist.numModules());  // Last module counted on each net
+    for (size_t i = 0; i < netlist.numModules(); ++i) {
+        if (netlist.isFixed(i)) continue;
+        area_[i] = netlist.area(i);
+        for (size_t k = netlist.modulePinBegin(i); k < netlist.modulePinEnd(i); ++k) {
+            const size_t net = netlist.pinNet(netlist.modulePin(k));
+            if (last_module[net] == i) continue;
+            last_module[net] = i;
+            degree_[i] += 1.0;
+        }
+    }
+}
+
+template <typename T>
+void JacobiPreconditioner<T>::apply(const std::vector<Point2<T>> &grad, std::vector<Point2<T>> &out) const {
+    for (size_t i = 0; i < grad.size(); ++i) {
+        out[i] = grad[i] * scale(i);
+    }
+}
+
+template <typename T>
+BoxConstraint<T>::BoxConstraint(const FlatNetlist &netlist)
+    : lower_(netlist.numModules(), Point2<T>(std::numeric_limits<T>::lowest(), std::numeric_limits<T>::lowest())),
+      upper_(netlist.numModules(), Point2<T>(std::numeric_limits<T>::max(), std::numeric_limits<T>::max())) {
+    const double center_x = (netlist.boundryLeft() + netlist.boundryRight()) / 2;
+    const double center_y = (netlist.boundryBottom() + netlist.boundryTop()) / 2;
+    for (size_t i = 0; i < netlist.numModules(); ++i) {
+        if (netlist.isFixed(i)) continue;
+        ++num_movable_;
+        const double half_w = netlist.width(i) / 2, half_h = netlist.height(i) / 2;
+        lower_[i] = Point2<T>(std::min(center_x, netlist.boundryLeft() + half_w), std::min(center_y, netlist.boundryBottom() + half_h));
+        upper_[i] = Point2<T>(std::max(center_x, netlist.boundryRight() - half_w), std::max(center_y, netlist.boundryTop() - half_h));
+    }
+}
+
+template <typename T>
+size_t BoxConstraint<T>::project(std::vector<Point2<T>> &pos) const {
+    size_t moved = 0;
+    for (size_t i = 0; i < pos.size(); ++i) {
+        const Point2<T> p(std::min(upper_[i].x, std::max(lower_[i].x, pos[i].x)), std::min(upper_[i].y, std::max(lower_[i].y, pos[i].y)));
+        if (p.x != pos[i].x || p.y != pos[i].y) {
+            pos[i] = p;
+            ++moved;
+        }
+    }
+    return moved;
+}
+
+template <typename T>
+void BoxConstraint<T>::clip(const std::vector<Point2<T>> &pos, std::vector<Point2<T>> &dir) const {
+    for (size_t i = 0; i < pos.size(); ++i) {
+        if ((pos[i].x <= lower_[i].x && dir[i].x < 0) || (pos[i].x >= upper_[i].x && dir[i].x > 0)) dir[i].x = 0;
+        if ((pos[i].y <= lower_[i].y && dir[i].y < 0) || (pos[i].y >= upper_[i].y && dir[i].y > 0)) dir[i].y = 0;
+    }
+}
+
+template <typename T>
+SimpleConjugateGradient<T>::SimpleConjugateGradient(BaseFunction<T> &obj,
+                                                 std::vector<Point2<T>> &var,
                                                  const double &alpha,
                                                  double boundary_left,
                                                  double boundary_right,
                                                  double boundary_top,
                                                  double boundary_bottom)
-        : BaseOptimizer(obj, var),
+        : BaseOptimizer<T>(obj, var),
         grad_prev_(var.size()),
+        raw_grad_prev_(var.size()),
         dir_prev_(var.size()),
+        dir_(var.size()),
         step_(0),
-        alpha_(alpha) {
+        alpha_(alpha),
+        step_size_(STEP_NORM),
+        predicted_alpha_(0.0),
+        conjugate_(true),
+        restart_(false),
+        evaluated_(false) {
         boundary_left_ = boundary_left;
         boundary_right_ = boundary_right;
         boundary_top_ = boundary_top;
         boundary_bottom_ = boundary_bottom;
     }
 
-void SimpleConjugateGradient::Initialize() {
+template <typename T>
+void SimpleConjugateGradient<T>::Initialize() {
     // Before the optimization starts, we need to initialize the optimizer.
     step_ = 0;
+    restart_ = false;
+    evaluated_ = false;
 }
 
 /**
- * @details Update the solution once using the conjugate gradient method.
+ * @details Update the solution once using the conjugate gradient method. The step works on
+ * preallocated buffers only: the direction is written into dir_ and rotated into dir_prev_, and
+ * the search gradient is swapped into grad_prev_ rather than copied.
  */
-void SimpleConjugateGradient::Step() {
+template <typename T>
+void SimpleConjugateGradient<T>::Step() {
     const size_t &kNumModule = var_.size();
 
-    // Compute the gradient direction
-    obj_(var_);       // Forward, compute the function value and cache from the input
-    obj_.Backward();  // Backward, compute the gradient according to the cache
-    // cout << "obj value: " << obj_.value() << endl; 
-
-    std::ofstream grad_file("plot_output/grad_vectors.txt");
-
-    for (size_t i = 0; i < var_.size(); ++i) {
-        const auto &pos = var_[i];
-        const auto &g = obj_.grad()[i];
-        double mag = std::sqrt(g.x * g.x + g.y * g.y);
-        grad_file << pos.x << " " << pos.y << " " << -g.x << " " << -g.y << " " << mag << "\n";
+    // Compute the gradient direction, unless the last step's search left it at var_
+    if (!evaluated_) {
+        obj_.ForwardBackward(var_);  // Compute the function value and the gradient in one pass
+        ++num_evaluations_;
     }
 
+    if (trace_) trace_->record(var_, obj_.grad());
+    const std::vector<Point2<T>> &grad = this->precondition(obj_.grad());  // Search gradient
 
-    grad_file.close();
     // Compute the Polak-Ribiere coefficient and conjugate directions
-    double beta;                                  // Polak-Ribiere coefficient
-    std::vector<Point2<double>> dir(kNumModule);  // conjugate directions
-    if (step_ == 0) {
-        // For the first step, we will set beta = 0 and d_0 = -g_0
+    double beta;                             // Polak-Ribiere coefficient
+    std::vector<Point2<T>> &dir = dir_;      // conjugate directions
+    if (step_ == 0 || restart_ || !conjugate_) {
+        // For the first step (or after a restart), we will set beta = 0 and d_0 = -g_0
         beta = 0.;
         for (size_t i = 0; i < kNumModule; ++i) {
-            dir[i] = -obj_.grad().at(i);
+            dir[i] = -grad[i];
         }
     } else {
         // For the remaining steps, we will calculate the Polak-Ribiere coefficient and
@@ -65,34 +186,27 @@ void SimpleConjugateGradient::Step() {
         double t1 = 0.;  // Store the numerator of beta
         double t2 = 0.;  // Store the denominator of beta
         for (size_t i = 0; i < kNumModule; ++i) {
-            Point2<double> t3 =
-                obj_.grad().at(i) * (obj_.grad().at(i) - grad_prev_.at(i));
+            Point2<T> t3 =
+                grad[i] * (grad[i] - grad_prev_[i]);
             t1 += t3.x + t3.y;
-            t2 += std::abs(obj_.grad().at(i).x) + std::abs(obj_.grad().at(i).y);
+            t2 += grad_prev_[i].x * grad_prev_[i].x + grad_prev_[i].y * grad_prev_[i].y;
         }
-        // beta = t1 / (t2 * t2);
+        // beta = t1 / |g_{k-1}|^2, reset to steepest descent when negative (PR+)
         const double epsilon = 1e-10;
-        if (std::abs(t2) < epsilon) {
+        if (t2 < epsilon) {
             beta = 0.0;
         } else {
-            beta = t1 / (t2 * t2);
+            beta = std::max(0.0, t1 / t2);
         }
 
         for (size_t i = 0; i < kNumModule; ++i) {
-            dir[i] = -obj_.grad().at(i) + beta * dir_prev_.at(i);
+            dir[i] = -grad[i] + T(beta) * dir_prev_[i];
 
         }
     }
+    this->clip(dir);
 
-    // Assume the step size is constant
-    // TODO(Optional): Change to dynamic step-size control
-
-    // === Dynamic Step-Size ===
-    // chip width 60000 -> 120000 step size
-    // chip width 2300 -> 4000 step size
-    // ratio = 2
-    // double s = 1000000.0; // target average move distance (tunable)
-    // cout << "boundary_left_ = " << boundary_left_ << ", boundary_right_ = " << boundary_right_ << endl;
+    // STEP_NORM moves a fixed distance along dir, proportional to the region width
     double s = ((boundary_right_ - boundary_left_) * 2.3); // target average move distance (tunable)
     double norm = 0.0;
     for (size_t i = 0; i < kNumModule; ++i) {
@@ -101,33 +215,365 @@ void SimpleConjugateGradient::Step() {
     norm = std::sqrt(norm); // L2 norm
 
     double dynamic_alpha = (norm < 1e-12) ? 0.0 : s / norm;
-    setAlpha(dynamic_alpha);  // or alpha_ = dynamic_alpha;
 
-    // std::cout << "[Dynamic Step Size] alpha = " << dynamic_alpha << ", norm = " << norm << std::endl;
+    bool moved = true;  // False if the line search found no decrease and kept var_
+    if (step_size_ == STEP_NORM) {
+        setAlpha(dynamic_alpha);
+        for (size_t i = 0; i < kNumModule; ++i) {
+            var_[i] = var_[i] + T(alpha_) * dir[i];
+        }
+    } else {
+        // The line searches need a descent direction; restart from steepest descent otherwise
+        double slope = 0.0;  // Directional derivative g_k . d_k
+        for (size_t i = 0; i < kNumModule; ++i) {
+            slope += obj_.grad()[i].x * dir[i].x + obj_.grad()[i].y * dir[i].y;
+        }
+        if (slope >= 0.0) {
+            norm = 0.0;
+            slope = 0.0;
+            for (size_t i = 0; i < kNumModule; ++i) dir[i] = -grad[i];
+            this->clip(dir);
+            for (size_t i = 0; i < kNumModule; ++i) {
+                norm += dir[i].x * dir[i].x + dir[i].y * dir[i].y;
+                slope += obj_.grad()[i].x * dir[i].x + obj_.grad()[i].y * dir[i].y;
+            }
+            norm = std::sqrt(norm);
+            dynamic_alpha = (norm < 1e-12) ? 0.0 : s / norm;
+        }
 
-    // Update the solution
-    // Please be aware of the updating directions, i.e., the sign for each term.
-    for (size_t i = 0; i < kNumModule; ++i) {
-        // Point2<double> ori = var_[i]; 
-        var_[i] = var_[i] + alpha_ * dir[i]; 
-        // Point2<double> new_pos = var_[i]; 
- 
-        // var_[i].x = max(boundary_left_ ,  min(var_[i].x, boundary_right_));
-        // var_[i].y = max(boundary_bottom_, min(var_[i].y, boundary_top_));
-        // if(var_[i].x < boundary_left_)
-        //     var_[i].x = boundary_left_;
-        // else if(var_[i].x > boundary_right_)
-        //     var_[i].x = boundary_right_;
-        // if(var_[i].y < boundary_bottom_)
-        //     var_[i].y = boundary_bottom_;
-        // else if(var_[i].y > boundary_top_)
-        //     var_[i].y = boundary_top_;
+        // The norm rule caps every trial, so no step moves further than it would. The trials
+        // overwrite the objective's gradient, so g_k moves to grad_prev_ first
+        this->takeGradient(grad_prev_);
+        if (step_size_ == STEP_ARMIJO) {
+            double alpha = step_ == 0 ? dynamic_alpha : std::min(dynamic_alpha, kStepGrowth * alpha_);
+            moved = this->armijoSearch(dir, slope, alpha);
+            setAlpha(alpha);
+        } else {
+            if (precond_) obj_.swapGrad(raw_grad_prev_);  // The raw g_k, the space of the slope
+            lipschitzSearch(dir, slope, norm, step_ == 0 ? dynamic_alpha : std::min(dynamic_alpha, predicted_alpha_));
+        }
+    }
+
+    // The line searches projected their trials already. The Lipschitz search evaluated the
+    // gradient at the accepted point, which the next step reuses.
+    const size_t projected = step_size_ == STEP_NORM ? this->project(var_) : this->trial_projected_;
+    evaluated_ = step_size_ == STEP_LIPSCHITZ;
+    restart_ = !moved || (box_ && projected > kRestartFraction * box_->numMovable());
+
+    // Update the cache data members
+    if (step_size_ == STEP_NORM) this->takeGradient(grad_prev_);
+    dir_prev_.swap(dir_);
+    step_++;
+}
 
+/**
+ * @details The ePlace step-size prediction along dir. A trial at step alpha evaluates the
+ * gradient there, which estimates the Lipschitz constant L = |g(x + alpha d) - g(x)| / (alpha
+ * |d|) at the current lambda, and predicts the step -slope / (L |d|^2) of the quadratic model
+ * (1 / L for steepest descent). The trial is accepted once it does not exceed the prediction by
+ * more than 1 / kAccept; otherwise the prediction is the next trial. Only gradients are
+ * compared, so the rule also works when the gradient is not the exact slope of the value.
+ * The slope is that of the raw gradient, so the differences are of raw gradients as well,
+ * also when the direction comes from preconditioned ones. The prediction at the accepted
+ * point is the first trial of the next step. The trials are placed by moveToTrial().
+ */
+template <typename T>
+void SimpleConjugateGradient<T>::lipschitzSearch(const std::vector<Point2<T>> &dir, double slope, double norm, double alpha) {
+    constexpr double kAccept = 0.95;
+    constexpr int kMaxTrials = 4;
 
+    const std::vector<Point2<T>> &grad_prev = precond_ ? raw_grad_prev_ : grad_prev_;  // Raw g_k
+    this->startSearch();
+    for (int trial = 1;; ++trial) {
+        this->moveToTrial(dir, alpha);
+        obj_.ForwardBackward(var_);
+        ++num_evaluations_;
+
+        const std::vector<Point2<T>> &grad = obj_.grad();
+        double dg = 0.0;
+        for (size_t i = 0; i < var_.size(); ++i) {
+            const Point2<T> d = grad[i] - grad_prev[i];
+            dg += d.x * d.x + d.y * d.y;
+        }
+        dg = std::sqrt(dg);
+        predicted_alpha_ = dg > 0.0 ? -slope * alpha / (dg * norm) : alpha;
+        if (predicted_alpha_ >= kAccept * alpha || trial == kMaxTrials) break;
+        alpha = predicted_alpha_;
     }
+    setAlpha(alpha);
+}
 
-    // Update the cache data members
-    grad_prev_ = obj_.grad();
-    dir_prev_ = dir;
+template <typename T>
+NesterovOptimizer<T>::NesterovOptimizer(BaseFunction<T> &obj,
+                                        std::vector<Point2<T>> &var,
+                                        double boundary_left,
+                                        double boundary_right,
+                                        double boundary_top,
+                                        double boundary_bottom)
+    : BaseOptimizer<T>(obj, var),
+      ref_(var.size()),
+      ref_grad_(var.size()),
+      ref_raw_grad_(var.size()),
+      next_(var.size()),
+      next_ref_(var.size()),
+      a_(1.0),
+      alpha_(0.0),
+      step_(0) {
+    boundary_left_ = boundary_left;
+    boundary_right_ = boundary_right;
+    boundary_top_ = boundary_top;
+    boundary_bottom_ = boundary_bottom;
+}
+
+template <typename T>
+void NesterovOptimizer<T>::Initialize() {
+    step_ = 0;
+    a_ = 1.0;
+}
+
+/**
+ * @details The first step starts from v_0 = u_0 = var_ and has no prediction yet; it tries the
+ * same move as the norm rule of SimpleConjugateGradient, |alpha g| = 2.3 region widths, which
+ * also caps every later prediction. The gradient reused from the previous step was evaluated
+ * before the placer last updated lambda, as in ePlace.
+ */
+template <typename T>
+void NesterovOptimizer<T>::Step() {
+    const size_t num_modules = var_.size();
+
+    if (step_ == 0) {
+        ref_ = var_;
+        obj_.ForwardBackward(ref_);
+        ++num_evaluations_;
+        this->precondition(obj_.grad());
+        this->takeGradient(ref_grad_);
+        if (precond_) obj_.swapGrad(ref_raw_grad_);
+    }
+    // The trace holds the raw gradient, like that of the other optimizers
+    if (trace_) trace_->record(ref_, precond_ ? ref_raw_grad_ : ref_grad_);
+
+    double grad_norm = 0.0;
+    for (size_t i = 0; i < num_modules; ++i) {
+        grad_norm += ref_grad_[i].x * ref_grad_[i].x + ref_grad_[i].y * ref_grad_[i].y;
+    }
+    grad_norm = std::sqrt(grad_norm);
+    const double max_alpha = grad_norm < 1e-12 ? 0.0 : (boundary_right_ - boundary_left_) * 2.3 / grad_norm;
+    double alpha = step_ == 0 ? max_alpha : std::min(alpha_, max_alpha);
+
+    const double next_a = (1.0 + std::sqrt(4.0 * a_ * a_ + 1.0)) / 2.0;
+    const T momentum = T((a_ - 1.0) / next_a);
+    double predicted = alpha;
+    for (int trial = 1;; ++trial) {
+        for (size_t i = 0; i < num_modules; ++i) {
+            next_[i] = ref_[i] - T(alpha) * ref_grad_[i];
+        }
+        this->project(next_);
+        for (size_t i = 0; i < num_modules; ++i) {
+            next_ref_[i] = next_[i] + momentum * (next_[i] - var_[i]);
+        }
+        this->project(next_ref_);
+        obj_.ForwardBackward(next_ref_);
+        ++num_evaluations_;
+
+        const std::vector<Point2<T>> &grad = this->precondition(obj_.grad());
+        double dx = 0.0, dg = 0.0;
+        for (size_t i = 0; i < num_modules; ++i) {
+            const Point2<T> ddx = next_ref_[i] - ref_[i];
+            const Point2<T> ddg = grad[i] - ref_grad_[i];
+            dx += ddx.x * ddx.x + ddx.y * ddx.y;
+            dg += ddg.x * ddg.x + ddg.y * ddg.y;
+        }
+        predicted = dg > 0.0 ? std::sqrt(dx / dg) : alpha;
+        if (predicted >= kAccept * alpha || trial == kMaxTrials) break;
+        alpha = predicted;
+    }
+
+    // Rotate the accepted trial in: u_{k+1}, v_{k+1} and its (preconditioned) gradient
+    var_.swap(next_);
+    ref_.swap(next_ref_);
+    this->takeGradient(ref_grad_);
+    if (precond_) obj_.swapGrad(ref_raw_grad_);
+    a_ = next_a;
+    alpha_ = predicted;
     step_++;
 }
+
+namespace {
+
+static_assert(sizeof(Point2<float>) == 2 * sizeof(float) && sizeof(Point2<double>) == 2 * sizeof(double),
+              "Point2 vectors are viewed as flat scalar arrays");
+
+template <typename T>
+T *flat(std::vector<Point2<T>> &v) {
+    return reinterpret_cast<T *>(v.data());
+}
+
+template <typename T>
+const T *flat(const std::vector<Point2<T>> &v) {
+    return reinterpret_cast<const T *>(v.data());
+}
+
+// a . b over n scalars, in four independent partial sums that the compiler vectorizes
+template <typename T>
+double dot(const T *a, const T *b, size_t n) {
+    double sum0 = 0.0, sum1 = 0.0, sum2 = 0.0, sum3 = 0.0;
+    size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+        sum0 += double(a[k]) * b[k];
+        sum1 += double(a[k + 1]) * b[k + 1];
+        sum2 += double(a[k + 2]) * b[k + 2];
+        sum3 += double(a[k + 3]) * b[k + 3];
+    }
+    for (; k < n; ++k) sum0 += double(a[k]) * b[k];
+    return (sum0 + sum1) + (sum2 + sum3);
+}
+
+// y += a * x over n scalars, unrolled by four like dot()
+template <typename T>
+void axpy(T a, const T *__restrict x, T *__restrict y, size_t n) {
+    size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+        y[k] += a * x[k];
+        y[k + 1] += a * x[k + 1];
+        y[k + 2] += a * x[k + 2];
+        y[k + 3] += a * x[k + 3];
+    }
+    for (; k < n; ++k) y[k] += a * x[k];
+}
+
+}  // namespace
+
+template <typename T>
+LBFGSOptimizer<T>::LBFGSOptimizer(BaseFunction<T> &obj,
+                                  std::vector<Point2<T>> &var,
+                                  size_t history,
+                                  double boundary_left,
+                                  double boundary_right,
+                                  double boundary_top,
+                                  double boundary_bottom)
+    : BaseOptimizer<T>(obj, var),
+      history_(std::max<size_t>(history, 1)),
+      size_(2 * var.size()),
+      s_(history_ * size_),
+      y_(history_ * size_),
+      rho_(history_),
+      coef_(history_),
+      newest_(0),
+      count_(0),
+      pending_row_(0),
+      pending_(false),
+      dir_(var.size()),
+      grad_prev_(var.size()),
+      step_(0) {
+    boundary_left_ = boundary_left;
+    boundary_right_ = boundary_right;
+    boundary_top_ = boundary_top;
+    boundary_bottom_ = boundary_bottom;
+}
+
+template <typename T>
+void LBFGSOptimizer<T>::Initialize() {
+    step_ = 0;
+    count_ = 0;
+    pending_ = false;
+}
+
+/**
+ * @details Stores the pair of the previous step, runs the two-loop recursion from the newest
+ * pair to the oldest and back, with the initial scaling H_0 = (s . y / y . y) I of the newest
+ * pair, and falls back to steepest descent (dropping the history) if the result is not a
+ * descent direction.
+ */
+template <typename T>
+void LBFGSOptimizer<T>::Step() {
+    const size_t n = size_;
+
+    obj_.ForwardBackward(var_);
+    ++num_evaluations_;
+    if (trace_) trace_->record(var_, obj_.grad());
+    const T *g = flat(obj_.grad());
+
+    // Curvature pair of the previous step: s = x_k - x_{k-1}, y = g_k - g_{k-1}, where the
+    // previous step left x_{k-1} in the row of s. A step whose search failed did not move and
+    // leaves no pair.
+    if (pending_) {
+        const size_t row = pending_row_;
+        T *s = s_.data() + row * n;
+        T *y = y_.data() + row * n;
+        const T *x = flat(var_), *g_prev = flat(grad_prev_);
+        for (size_t k = 0; k < n; ++k) {
+            s[k] = x[k] - s[k];
+            y[k] = g[k] - g_prev[k];
+        }
+        const double sy = dot(s, y, n);
+        if (sy > 0.0) {
+            rho_[row] = 1.0 / sy;
+            newest_ = row;
+            count_ = std::min(count_ + 1, history_);
+        } else if (count_ == history_) {
+            --count_;  // The rejected pair overwrote the oldest one
+        }
+    }
+
+    // Two-loop recursion: q = g, then d = -H q
+    T *d = flat(dir_);
+    for (size_t k = 0; k < n; ++k) d[k] = g[k];
+    for (size_t j = 0; j < count_; ++j) {
+        const size_t row = (newest_ + history_ - j) % history_;
+        coef_[row] = rho_[row] * dot(s_.data() + row * n, d, n);
+        axpy(T(-coef_[row]), y_.data() + row * n, d, n);
+    }
+    if (count_ > 0) {
+        // H_0 = gamma P, with P the preconditioner (identity without one)
+        const T *y = y_.data() + newest_ * n;
+        double ypy = 0.0;
+        for (size_t k = 0; k < n; ++k) {
+            const T p = precond_ ? precond_->scale(k / 2) : T(1);
+            ypy += double(y[k]) * y[k] * p;
+            d[k] *= p;
+        }
+        const T gamma = T(ypy > 0.0 ? 1.0 / (rho_[newest_] * ypy) : 1.0);
+        for (size_t k = 0; k < n; ++k) d[k] *= gamma;
+    }
+    for (size_t j = count_; j-- > 0;) {
+        const size_t row = (newest_ + history_ - j) % history_;
+        const double beta = rho_[row] * dot(y_.data() + row * n, d, n);
+        axpy(T(coef_[row] - beta), s_.data() + row * n, d, n);
+    }
+    for (size_t k = 0; k < n; ++k) d[k] = -d[k];
+    this->clip(dir_);
+
+    double slope = dot(g, d, n);
+    if (count_ == 0 || slope >= 0.0) {
+        count_ = 0;
+        const T *h = flat(this->precondition(obj_.grad()));
+        for (size_t k = 0; k < n; ++k) d[k] = -h[k];
+        this->clip(dir_);
+        slope = dot(g, d, n);
+    }
+
+    // Quasi-Newton step 1, capped by the norm rule; steepest descent starts at the cap
+    const double norm = std::sqrt(dot(d, d, n));
+    const double max_alpha = norm < 1e-12 ? 0.0 : (boundary_right_ - boundary_left_) * 2.3 / norm;
+    obj_.swapGrad(grad_prev_);  // The trials are forward passes only
+    const T *x = flat(var_);
+    pending_row_ = count_ == 0 ? 0 : (newest_ + 1) % history_;
+    std::copy(x, x + n, s_.data() + pending_row_ * n);
+    double alpha = count_ == 0 ? max_alpha : std::min(1.0, max_alpha);
+    pending_ = this->armijoSearch(dir_, slope, alpha);
+    if (!pending_) count_ = 0;  // Restart from steepest descent
+    step_++;
+}
+
+template class BoxConstraint<float>;
+template class BoxConstraint<double>;
+template class JacobiPreconditioner<float>;
+template class JacobiPreconditioner<double>;
+template class BaseOptimizer<float>;
+template class BaseOptimizer<double>;
+template class SimpleConjugateGradient<float>;
+template class SimpleConjugateGradient<double>;
+template class NesterovOptimizer<float>;
+template class NesterovOptimizer<double>;
+template class LBFGSOptimizer<float>;
+template class LBFGSOptimizer<double>;
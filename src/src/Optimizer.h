@@ -4,18 +4,111 @@
 
 #include "ObjectiveFunction.h"
 #include "Point.h"
+#include "TraceWriter.h"
+
+/**
+ * @brief Step-size rule of SimpleConjugateGradient
+ */
+enum StepSizeRule {
+    STEP_NORM,      // Fixed move: alpha = s / |d| with s proportional to the region width
+    STEP_ARMIJO,    // Armijo backtracking from the previous step size, capped by STEP_NORM
+    STEP_LIPSCHITZ  // ePlace Lipschitz-constant prediction with step acceptance, capped by STEP_NORM
+};
+
+/**
+ * @brief Jacobi (diagonal) preconditioner of the placement gradient, as in ePlace
+ *
+ * The diagonal of the Hessian of wirelength + lambda * density is approximated per module by
+ * H_i = (nets of module i) + lambda * (area of module i). apply() divides every gradient by
+ * max(1, H_i), so modules on many nets and large macros no longer take steps orders of
+ * magnitude longer than small cells. The net degrees and areas are computed once;
+ * setLambda() only stores the new lambda.
+ */
+template <typename T>
+class JacobiPreconditioner {
+   public:
+    /////////////////////////////////
+    // Constructors
+    /////////////////////////////////
+
+    explicit JacobiPreconditioner(const FlatNetlist &netlist);
+
+    /////////////////////////////////
+    // Accessors
+    /////////////////////////////////
+
+    void setLambda(double lambda) { lambda_ = lambda; }
+    double getLambda() const { return lambda_; }
+
+    // 1 / max(1, H_i) of module i
+    T scale(size_t moduleId) const { return T(1.0 / std::max(1.0, degree_[moduleId] + lambda_ * area_[moduleId])); }
+
+    /////////////////////////////////
+    // Methods
+    /////////////////////////////////
+
+    // out[i] = grad[i] * scale(i)
+    void apply(const std::vector<Point2<T>> &grad, std::vector<Point2<T>> &out) const;
+
+   private:
+    std::vector<double> degree_;  // Distinct nets of every movable module, 0 if fixed
+    std::vector<double> area_;    // Area of every movable module, 0 if fixed
+    double lambda_ = 0.0;         // Density weight of the objective
+};
+
+/**
+ * @brief Per-module box constraints keeping every module inside the placement region
+ *
+ * The positions are module centers, so module i stays inside the region while its center is
+ * within [left + w_i / 2, right - w_i / 2] x [bottom + h_i / 2, top - h_i / 2]; a module wider
+ * or taller than the region is centered along that axis. Fixed modules are never moved.
+ */
+template <typename T>
+class BoxConstraint {
+   public:
+    /////////////////////////////////
+    // Constructors
+    /////////////////////////////////
+
+    explicit BoxConstraint(const FlatNetlist &netlist);
+
+    /////////////////////////////////
+    // Accessors
+    /////////////////////////////////
+
+    size_t numMovable() const { return num_movable_; }
+
+    /////////////////////////////////
+    // Methods
+    /////////////////////////////////
+
+    // Clamp every movable module of pos into its box; returns the number of modules moved
+    size_t project(std::vector<Point2<T>> &pos) const;
+
+    // Zero the components of dir that would move a module at a bound of its box out of it
+    void clip(const std::vector<Point2<T>> &pos, std::vector<Point2<T>> &dir) const;
+
+   private:
+    std::vector<Point2<T>> lower_;  // Lowest center of every module, -inf if fixed
+    std::vector<Point2<T>> upper_;  // Highest center of every module, +inf if fixed
+    size_t num_movable_ = 0;
+};
 
 /**
  * @brief Base class for optimizers
+ *
+ * @tparam T Floating-point type of the variables and gradients (float or double)
  */
+template <typename T>
 class BaseOptimizer {
     public:
         /////////////////////////////////
         // Constructors
         /////////////////////////////////
 
-        BaseOptimizer(BaseFunction &obj, std::vector<Point2<double>> &var)
+        BaseOptimizer(BaseFunction<T> &obj, std::vector<Point2<T>> &var)
             : obj_(obj), var_(var) {}
+        virtual ~BaseOptimizer() = default;
 
         /////////////////////////////////
         // Methods
@@ -29,6 +122,23 @@ class BaseOptimizer {
         //     var_ = var_ - learning_rate * obj_.grad();
         virtual void Step() = 0;
 
+        // Snapshot the positions and gradients of every step into trace (null disables)
+        void setTrace(TraceWriter *trace) { trace_ = trace; }
+
+        // Objective evaluations so far, line-search and backtracking trials included
+        size_t numEvaluations() const { return num_evaluations_; }
+
+        // Search along preconditioned gradients (null disables); the preconditioner is held by
+        // pointer, its lambda is kept up to date by the caller
+        void setPreconditioner(const JacobiPreconditioner<T> *precond) {
+            precond_ = precond;
+            precond_grad_.resize(precond ? var_.size() : 0);
+        }
+
+        // Project the positions into box after every step (null disables); the box is held by
+        // pointer and must outlive the optimizer
+        void setBounds(const BoxConstraint<T> *box) { box_ = box; }
+
     protected:
         /////////////////////////////////
         // Data members
@@ -38,20 +148,85 @@ class BaseOptimizer {
         double boundary_top_;   // Top boundary of the placement area
         double boundary_bottom_; // Bottom boundary of the placement area
 
-        BaseFunction &obj_;                 // Objective function to optimize
-        std::vector<Point2<double>> &var_;  // Variables to optimize
+        BaseFunction<T> &obj_;         // Objective function to optimize
+        std::vector<Point2<T>> &var_;  // Variables to optimize
+        TraceWriter *trace_ = nullptr; // Sink of the per-step snapshots, if tracing is on
+        size_t num_evaluations_ = 0;   // Objective evaluations so far
+        const JacobiPreconditioner<T> *precond_ = nullptr;  // Preconditioner, if any
+        std::vector<Point2<T>> precond_grad_;                // Result of precondition()
+        const BoxConstraint<T> *box_ = nullptr;              // Box constraints, if any
+        std::vector<Point2<T>> start_;                       // Start of the line search
+        size_t trial_projected_ = 0;                         // Modules projected at the last trial
+
+        // grad preconditioned by precond_ (into precond_grad_, overwritten by the next call), or
+        // grad itself without a preconditioner
+        const std::vector<Point2<T>> &precondition(const std::vector<Point2<T>> &grad) {
+            if (!precond_) return grad;
+            precond_->apply(grad, precond_grad_);
+            return precond_grad_;
+        }
+
+        // Move the gradient last returned by precondition() into dest by exchanging buffers, in
+        // O(1); it is no longer readable through precondition()'s result or obj_.grad()
+        void takeGradient(std::vector<Point2<T>> &dest) {
+            if (precond_) {
+                precond_grad_.swap(dest);
+            } else {
+                obj_.swapGrad(dest);
+            }
+        }
+
+        // Clamp pos into box_, if any; returns the number of modules moved
+        size_t project(std::vector<Point2<T>> &pos) { return box_ ? box_->project(pos) : 0; }
+
+        // Restrict the search direction dir at var_ to the box_, if any
+        void clip(std::vector<Point2<T>> &dir) const {
+            if (box_) box_->clip(var_, dir);
+        }
+
+        // Begin a line search from var_: its buffer moves to start_ in O(1) and var_ takes the
+        // old one, which every trial overwrites
+        void startSearch() {
+            start_.resize(var_.size());
+            var_.swap(start_);
+        }
+
+        // Set var_ to the start of the search plus alpha * dir, projected into the box if any
+        // (counted in trial_projected_)
+        void moveToTrial(const std::vector<Point2<T>> &dir, double alpha);
+
+        // Move var_ along dir, whose slope g . dir at var_ is negative, with Armijo backtracking
+        // from the trial step alpha. Returns false, with var_ back at its start, if no trial
+        // decreased the objective; alpha is then the last trial, else the step taken.
+        bool armijoSearch(const std::vector<Point2<T>> &dir, double slope, double &alpha);
 };
 
 /**
- * @brief Simple conjugate gradient optimizer with constant step size
+ * @brief Polak-Ribiere conjugate gradient optimizer
+ *
+ * By default every step moves by s / |d| along the direction d, without checking the
+ * objective. The line-search rules (setStepSize()) try steps along d and accept one by
+ * the decrease of the objective (STEP_ARMIJO, forward passes only) or by the local Lipschitz
+ * constant of the gradient (STEP_LIPSCHITZ).
+ *
+ * STEP_LIPSCHITZ evaluates the gradient at every trial, so the next step starts from the
+ * accepted trial's value and gradient instead of evaluating the objective again. If no
+ * STEP_ARMIJO trial decreases the objective, the step is not taken and the next one restarts
+ * from steepest descent.
+ *
+ * With box constraints (setBounds()), d_k drops the components that would push a module at
+ * its bound out of the box, and every trial point is projected into the box. If the
+ * projection moved more than kRestartFraction of the movable modules, d_k no longer describes
+ * the step taken, and the next step restarts from steepest descent.
  */
-class SimpleConjugateGradient : public BaseOptimizer {
+template <typename T>
+class SimpleConjugateGradient : public BaseOptimizer<T> {
    public:
     /////////////////////////////////
     // Constructors
     /////////////////////////////////
 
-    SimpleConjugateGradient(BaseFunction &obj, std::vector<Point2<double>> &var, const double &alpha, double boundary_left = 0, double boundary_right = 0, double boundary_top = 0, double boundary_bottom = 0);
+    SimpleConjugateGradient(BaseFunction<T> &obj, std::vector<Point2<T>> &var, const double &alpha, double boundary_left = 0, double boundary_right = 0, double boundary_top = 0, double boundary_bottom = 0);
 
 
     /////////////////////////////////
@@ -64,21 +239,180 @@ class SimpleConjugateGradient : public BaseOptimizer {
     // Perform one optimization step
     void Step() override;
     void setAlpha(double alpha) { alpha_ = alpha; }  // Optional: expose dynamic α adjustment
+    void setStepSize(StepSizeRule rule) { step_size_ = rule; }
+    // False takes steepest-descent directions only, for a gradient that is not the slope of
+    // the value (such as that of the field penalty of Density)
+    void setConjugate(bool conjugate) { conjugate_ = conjugate; }
 
    private:
+    static constexpr double kStepGrowth = 2.0;       // STEP_ARMIJO: first trial over the last step size
+    static constexpr double kRestartFraction = 0.05; // Projected modules that restart the directions
+
     /////////////////////////////////
     // Data members
     /////////////////////////////////
    
 
-    std::vector<Point2<double>> grad_prev_;  // Gradient of the objective function at the previous
-                                             // step, i.e., g_{k-1} in the NTUPlace3 paper
-    std::vector<Point2<double>> dir_prev_;   // Direction of the previous step,
-                                             // i.e., d_{k-1} in the NTUPlace3 paper
-    size_t step_;                            // Current step number
-    double alpha_;                           // Step size
+    std::vector<Point2<T>> grad_prev_;  // Gradient of the objective function at the previous
+                                        // step, i.e., g_{k-1} in the NTUPlace3 paper
+    std::vector<Point2<T>> raw_grad_prev_;  // STEP_LIPSCHITZ with a preconditioner: g_k before
+                                            // preconditioning
+    std::vector<Point2<T>> dir_prev_;   // Direction of the previous step,
+                                        // i.e., d_{k-1} in the NTUPlace3 paper
+    std::vector<Point2<T>> dir_;        // Direction d_k; swapped into dir_prev_ after the step
+    size_t step_;                       // Current step number
+    double alpha_;                      // Step size
+    StepSizeRule step_size_;            // Step-size rule
+    double predicted_alpha_;            // STEP_LIPSCHITZ: step predicted at the last accepted point
+    bool conjugate_;                    // Conjugate directions; false keeps beta = 0
+    bool restart_;                      // Next direction is steepest descent, beta = 0
+    bool evaluated_;                    // obj_ holds the value and gradient at var_ already
+
+    // Move var_ along dir, whose slope is g_k . d_k < 0, with the ePlace step prediction
+    // starting from the trial step alpha; leaves the accepted step size in alpha_
+    void lipschitzSearch(const std::vector<Point2<T>> &dir, double slope, double norm, double alpha);
+
+    using BaseOptimizer<T>::boundary_left_;
+    using BaseOptimizer<T>::boundary_right_;
+    using BaseOptimizer<T>::boundary_top_;
+    using BaseOptimizer<T>::boundary_bottom_;
+    using BaseOptimizer<T>::obj_;
+    using BaseOptimizer<T>::var_;
+    using BaseOptimizer<T>::trace_;
+    using BaseOptimizer<T>::num_evaluations_;
+    using BaseOptimizer<T>::precond_;
+    using BaseOptimizer<T>::box_;
+};
+
+/**
+ * @brief Nesterov's accelerated gradient method with the ePlace step-size prediction
+ *
+ * Keeps the major solution u_k in var_ and the reference solution v_k, where the gradient is
+ * evaluated. A step is
+ *     u_{k+1} = v_k - alpha_k g(v_k)
+ *     a_{k+1} = (1 + sqrt(4 a_k^2 + 1)) / 2
+ *     v_{k+1} = u_{k+1} + (a_k - 1) / a_{k+1} * (u_{k+1} - u_k)
+ * with alpha_k the inverse Lipschitz constant |v_k - v_{k-1}| / |g(v_k) - g(v_{k-1})| predicted
+ * at the previous step (Barzilai-Borwein). The gradient at v_{k+1} is evaluated to check the
+ * step: if the prediction there is below kAccept * alpha_k, the step overshot and is redone
+ * with the new prediction. An accepted step's gradient is the one the next step starts from,
+ * so an iteration costs a single forward/backward pass unless it backtracks. With box
+ * constraints, u_{k+1} and v_{k+1} are projected into the box before the gradient is evaluated.
+ */
+template <typename T>
+class NesterovOptimizer : public BaseOptimizer<T> {
+   public:
+    /////////////////////////////////
+    // Constructors
+    /////////////////////////////////
+
+    NesterovOptimizer(BaseFunction<T> &obj, std::vector<Point2<T>> &var, double boundary_left = 0, double boundary_right = 0, double boundary_top = 0, double boundary_bottom = 0);
+
+    /////////////////////////////////
+    // Methods
+    /////////////////////////////////
+
+    // Initialize the optimizer
+    void Initialize() override;
+
+    // Perform one optimization step
+    void Step() override;
+
+   private:
+    static constexpr double kAccept = 0.95;  // Accept a step down to this fraction of the new prediction
+    static constexpr int kMaxTrials = 4;     // Steps tried per iteration before accepting anyway
+
+    /////////////////////////////////
+    // Data members
+    /////////////////////////////////
+
+    std::vector<Point2<T>> ref_;        // Reference solution v_k
+    std::vector<Point2<T>> ref_grad_;   // Gradient at v_k, from the previous step's evaluation
+    std::vector<Point2<T>> ref_raw_grad_;  // The same before preconditioning, with a preconditioner
+    std::vector<Point2<T>> next_;       // Major solution u_{k+1} of the current trial
+    std::vector<Point2<T>> next_ref_;   // Reference solution v_{k+1} of the current trial
+    double a_;                          // Momentum coefficient a_k
+    double alpha_;                      // Predicted step size alpha_k
+    size_t step_;                       // Current step number
+
+    using BaseOptimizer<T>::boundary_left_;
+    using BaseOptimizer<T>::boundary_right_;
+    using BaseOptimizer<T>::boundary_top_;
+    using BaseOptimizer<T>::boundary_bottom_;
+    using BaseOptimizer<T>::obj_;
+    using BaseOptimizer<T>::var_;
+    using BaseOptimizer<T>::trace_;
+    using BaseOptimizer<T>::num_evaluations_;
+    using BaseOptimizer<T>::precond_;
 };
 
-// TODO(Optional): Implement your own optimizer.
+/**
+ * @brief Limited-memory BFGS optimizer
+ *
+ * The direction is d_k = -H_k g_k, with H_k the inverse Hessian approximation built by the
+ * two-loop recursion from the last m curvature pairs s_i = x_{i+1} - x_i and y_i = g_{i+1} -
+ * g_i. The step along d_k comes from the Armijo line search, starting at the quasi-Newton step
+ * 1 and never moving further than the norm rule of SimpleConjugateGradient.
+ *
+ * The pairs live in one preallocated ring buffer of flat scalar arrays (x and y coordinates
+ * interleaved, as in the Point2 vectors), and the recursion works on flat views of the
+ * positions and gradients, so a step allocates nothing. A pair with s_i . y_i <= 0 (as when a
+ * lambda update changes the objective between two steps) would break the positive
+ * definiteness of H_k and is skipped. If the line search finds no decrease, the step is not
+ * taken, the history is dropped and no pair is stored for it. With box constraints, d_k is
+ * clipped at the bounds like the conjugate gradient direction, the line-search trials are
+ * projected into the box, and s_i is the step actually taken.
+ */
+template <typename T>
+class LBFGSOptimizer : public BaseOptimizer<T> {
+   public:
+    /////////////////////////////////
+    // Constructors
+    /////////////////////////////////
+
+    LBFGSOptimizer(BaseFunction<T> &obj, std::vector<Point2<T>> &var, size_t history, double boundary_left = 0, double boundary_right = 0, double boundary_top = 0, double boundary_bottom = 0);
+
+    /////////////////////////////////
+    // Methods
+    /////////////////////////////////
+
+    // Initialize the optimizer
+    void Initialize() override;
+
+    // Perform one optimization step
+    void Step() override;
+
+    // Curvature pairs the next direction is built from
+    size_t numPairs() const { return count_; }
+
+   private:
+    /////////////////////////////////
+    // Data members
+    /////////////////////////////////
+
+    size_t history_;               // Capacity m of the ring buffer
+    size_t size_;                  // Scalars per pair: 2 * modules
+    std::vector<T> s_;             // history_ rows of size_ scalars: s_i
+    std::vector<T> y_;             // history_ rows of size_ scalars: y_i
+    std::vector<double> rho_;      // 1 / (s_i . y_i) of every row
+    std::vector<double> coef_;     // Coefficients of the first loop of the recursion
+    size_t newest_;                // Row of the newest pair
+    size_t count_;                 // Pairs stored, at most history_
+    size_t pending_row_;           // Row holding x_{k-1} for the next pair
+    bool pending_;                 // The previous step moved, so the next one stores a pair
+    std::vector<Point2<T>> dir_;   // Direction d_k
+    std::vector<Point2<T>> grad_prev_;  // Gradient g_{k-1}, swapped out of the objective
+    size_t step_;                  // Current step number
+
+    using BaseOptimizer<T>::boundary_left_;
+    using BaseOptimizer<T>::boundary_right_;
+    using BaseOptimizer<T>::boundary_top_;
+    using BaseOptimizer<T>::boundary_bottom_;
+    using BaseOptimizer<T>::obj_;
+    using BaseOptimizer<T>::var_;
+    using BaseOptimizer<T>::trace_;
+    using BaseOptimizer<T>::num_evaluations_;
+    using BaseOptimizer<T>::precond_;
+};
 
 #endif  // OPTIMIZER_H
@@ -0,0 +1,110 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template <typename Signature>
+class FunctionRef;
+
+/**
+ * @brief Non-owning reference to a callable, like std::function without the allocation
+ *
+ * Holds a pointer to the callable and a function that calls it, so it must not outlive the
+ * callable it was built from. Cheap to copy and to pass by value.
+ */
+template <typename R, typename... Args>
+class FunctionRef<R(Args...)> {
+   public:
+    template <typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, FunctionRef>::value>>
+    FunctionRef(F &&f)
+        : object_(const_cast<void *>(static_cast<const void *>(std::addressof(f)))),
+          call_([](void *object, Args... args) -> R {
+              return (*static_cast<std::remove_reference_t<F> *>(object))(std::forward<Args>(args)...);
+          }) {}
+
+    R operator()(Args... args) const { return call_(object_, std::forward<Args>(args)...); }
+
+   private:
+    void *object_;
+    R (*call_)(void *, Args...);
+};
+
+/**
+ * @brief Fixed-size pool of worker threads for data-parallel loops
+ *
+ * The calling thread takes part in the work, so a pool of N threads spawns N-1 workers and a
+ * pool of one thread runs everything inline. The split of a range among threads depends only
+ * on the range and the thread count, never on scheduling.
+ */
+class ThreadPool {
+   public:
+    /////////////////////////////////
+    // Constructors
+    /////////////////////////////////
+
+    explicit ThreadPool(size_t num_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /////////////////////////////////
+    // Accessors
+    /////////////////////////////////
+
+    size_t numThreads() const { return workers_.size() + 1; }
+
+    /////////////////////////////////
+    // Methods
+    /////////////////////////////////
+
+    // Run task(t) on every thread t in [0, numThreads()) and wait for all of them
+    void run(FunctionRef<void(size_t)> task);
+
+    // Split [begin, end) into numThreads() contiguous chunks and run body(lo, hi) on each, or
+    // body(lo, hi, t) if body takes the index t of the thread running the chunk
+    template <typename Body>
+    void parallelFor(size_t begin, size_t end, const Body &body);
+
+   private:
+    /////////////////////////////////
+    // Data members
+    /////////////////////////////////
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    const FunctionRef<void(size_t)> *task_ = nullptr;    // Task of the current run()
+    size_t generation_ = 0;                              // Incremented by every run()
+    size_t pending_ = 0;                                 // Workers still busy in this run()
+    bool stop_ = false;
+
+    void workerLoop(size_t thread_id);
+};
+
+template <typename Body>
+void ThreadPool::parallelFor(size_t begin, size_t end, const Body &body) {
+    if (begin >= end) return;
+    const size_t num_threads = numThreads();
+    const size_t count = end - begin;
+    run([&](size_t t) {
+        const size_t lo = begin + count * t / num_threads;
+        const size_t hi = begin + count * (t + 1) / num_threads;
+        if (lo >= hi) return;
+        if constexpr (std::is_invocable<const Body &, size_t, size_t, size_t>::value) {
+            body(lo, hi, t);
+        } else {
+            body(lo, hi);
+        }
+    });
+}
+
+#endif  // THREADPOOL_H
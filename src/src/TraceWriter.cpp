@@ -0,0 +1,104 @@
+#include "TraceWriter.h"
+
+#include <cstring>
+
+TraceWriter::TraceWriter(const char *filename, size_t every) : every_(every > 0 ? every : 1) {
+    file_ = std::fopen(filename, "wb");
+    if (!file_) {
+        printf("WARNING: cannot open trace file %s, tracing is disabled.\n", filename);
+        return;
+    }
+    std::fwrite(kMagic, 1, sizeof(kMagic), file_);
+    std::fwrite(&kVersion, sizeof(kVersion), 1, file_);
+    writer_ = std::thread(&TraceWriter::writerLoop, this);
+}
+
+TraceWriter::~TraceWriter() {
+    close();
+}
+
+void TraceWriter::close() {
+    if (!file_) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    queued_cv_.notify_one();
+    writer_.join();
+    std::fclose(file_);
+    file_ = nullptr;
+}
+
+/**
+ * @details Blocks while kMaxQueued frames are waiting for the writer, which bounds the memory
+ * of the trace to kMaxQueued + 1 snapshots.
+ */
+TraceWriter::Frame TraceWriter::acquireFrame() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    freed_cv_.wait(lock, [this] { return queue_.size() < kMaxQueued; });
+    if (free_.empty()) return Frame();
+    Frame frame = std::move(free_.back());
+    free_.pop_back();
+    return frame;
+}
+
+void TraceWriter::submitFrame(Frame frame) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(frame));
+        ++num_frames_;
+    }
+    queued_cv_.notify_one();
+}
+
+/**
+ * @details Writes the frames in queue order without holding the lock, and exits once stop_
+ * is set and the queue is drained.
+ */
+void TraceWriter::writerLoop() {
+    while (true) {
+        Frame frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queued_cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            frame = std::move(queue_.front());
+            queue_.pop_front();
+        }
+
+        const uint64_t count = frame.data.size() / 4;
+        std::fwrite(&frame.step, sizeof(frame.step), 1, file_);
+        std::fwrite(&count, sizeof(count), 1, file_);
+        std::fwrite(frame.data.data(), sizeof(float), frame.data.size(), file_);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_.push_back(std::move(frame));
+        }
+        freed_cv_.notify_one();
+    }
+}
+
+TraceReader::TraceReader(const char *filename) {
+    file_ = std::fopen(filename, "rb");
+    if (!file_) return;
+    char magic[4];
+    uint32_t version;
+    if (std::fread(magic, 1, sizeof(magic), file_) != sizeof(magic) || std::memcmp(magic, TraceWriter::kMagic, sizeof(magic)) != 0 ||
+        std::fread(&version, sizeof(version), 1, file_) != 1 || version != TraceWriter::kVersion) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+TraceReader::~TraceReader() {
+    if (file_) std::fclose(file_);
+}
+
+bool TraceReader::next(uint64_t &step, std::vector<float> &data) {
+    if (!file_) return false;
+    uint64_t count;
+    if (std::fread(&step, sizeof(step), 1, file_) != 1 || std::fread(&count, sizeof(count), 1, file_) != 1) return false;
+    data.resize(4 * count);
+    return std::fread(data.data(), sizeof(float), data.size(), file_) == data.size();
+}
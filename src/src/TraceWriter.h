@@ -0,0 +1,144 @@
+#ifndef TRACEWRITER_H
+#define TRACEWRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Point.h"
+
+/**
+ * @brief Background writer of optimizer snapshots (positions and gradients) to a binary trace
+ *
+ * record() is called once per optimizer step. Every every-th step, counted from 0, it copies
+ * the positions and gradients into a recycled frame buffer and hands it to a writer thread,
+ * so the optimizer never waits for the disk unless kMaxQueued frames are already pending.
+ *
+ * File layout, little-endian as written by the host:
+ *     header: char magic[4] = "GPTR", uint32 version = 1
+ *     frame:  uint64 step, uint64 count, then count records of float32 x, y, gx, gy
+ * Snapshots are stored in float32 whatever the precision of the placer: the text layout they
+ * are converted to (TraceReader, bin/trace2txt) prints 6 significant digits.
+ */
+class TraceWriter {
+   public:
+    static constexpr char kMagic[4] = {'G', 'P', 'T', 'R'};
+    static constexpr uint32_t kVersion = 1;
+
+    /////////////////////////////////
+    // Constructors
+    /////////////////////////////////
+
+    // Open filename for writing; on failure isOpen() is false and record() does nothing
+    TraceWriter(const char *filename, size_t every);
+    ~TraceWriter();
+
+    TraceWriter(const TraceWriter &) = delete;
+    TraceWriter &operator=(const TraceWriter &) = delete;
+
+    /////////////////////////////////
+    // Accessors
+    /////////////////////////////////
+
+    bool isOpen() const { return file_ != nullptr; }
+    size_t numFrames() const { return num_frames_; }
+
+    /////////////////////////////////
+    // Methods
+    /////////////////////////////////
+
+    // Count one optimizer step and queue its snapshot if the step is due
+    template <typename T>
+    void record(const std::vector<Point2<T>> &pos, const std::vector<Point2<T>> &grad);
+
+    // Write out the pending frames and close the file
+    void close();
+
+   private:
+    static constexpr size_t kMaxQueued = 4;  // Frames queued before record() blocks
+
+    struct Frame {
+        uint64_t step = 0;
+        std::vector<float> data;  // x, y, gx, gy of every module
+    };
+
+    /////////////////////////////////
+    // Data members
+    /////////////////////////////////
+
+    std::FILE *file_ = nullptr;
+    size_t every_;            // Decimation: a frame every every_ steps
+    size_t step_ = 0;         // Steps counted by record()
+    size_t num_frames_ = 0;   // Frames queued so far
+
+    std::thread writer_;
+    std::mutex mutex_;
+    std::condition_variable queued_cv_;  // Signals the writer: a frame was queued or stop_
+    std::condition_variable freed_cv_;   // Signals record(): the writer freed a slot
+    std::deque<Frame> queue_;            // Frames waiting for the writer
+    std::vector<Frame> free_;            // Written frames, recycled by record()
+    bool stop_ = false;
+
+    Frame acquireFrame();
+    void submitFrame(Frame frame);
+    void writerLoop();
+};
+
+/**
+ * @brief Sequential reader of a trace written by TraceWriter
+ */
+class TraceReader {
+   public:
+    /////////////////////////////////
+    // Constructors
+    /////////////////////////////////
+
+    explicit TraceReader(const char *filename);
+    ~TraceReader();
+
+    TraceReader(const TraceReader &) = delete;
+    TraceReader &operator=(const TraceReader &) = delete;
+
+    /////////////////////////////////
+    // Accessors
+    /////////////////////////////////
+
+    // True if the file opened and its header is a supported trace header
+    bool isValid() const { return file_ != nullptr; }
+
+    /////////////////////////////////
+    // Methods
+    /////////////////////////////////
+
+    // Read the next frame into step and data (x, y, gx, gy per module); false at the end of
+    // the trace or on a truncated frame
+    bool next(uint64_t &step, std::vector<float> &data);
+
+   private:
+    std::FILE *file_ = nullptr;
+};
+
+template <typename T>
+void TraceWriter::record(const std::vector<Point2<T>> &pos, const std::vector<Point2<T>> &grad) {
+    if (!file_) return;
+    const size_t step = step_++;
+    if (step % every_ != 0) return;
+
+    Frame frame = acquireFrame();
+    frame.step = step;
+    frame.data.resize(4 * pos.size());
+    float *out = frame.data.data();
+    for (size_t i = 0; i < pos.size(); ++i, out += 4) {
+        out[0] = (float)pos[i].x;
+        out[1] = (float)pos[i].y;
+        out[2] = (float)grad[i].x;
+        out[3] = (float)grad[i].y;
+    }
+    submitFrame(std::move(frame));
+}
+
+#endif  // TRACEWRITER_H
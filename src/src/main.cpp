@@ -12,7 +12,7 @@
 #include <time.h>
 
 using namespace std;
-bool handleArgument( const int& argc, char* argv[], CParamPlacement& param )
+bool handleArgument( const int& argc, char* argv[], CParamPlacement& param, GlobalPlacerOptions& gpOptions )
 {
 
     int i;
@@ -44,6 +44,116 @@ bool handleArgument( const int& argc, char* argv[], CParamPlacement& param )
         else if( strcmp( argv[i]+1, "loadpl" ) == 0 ){
             param.plFilename = string( argv[++i] );
         }
+        else if( strcmp( argv[i]+1, "threads" ) == 0 && i + 1 < argc ){
+            param.threadNum = max( 1, atoi( argv[++i] ) );
+        }
+        else if( strcmp( argv[i]+1, "hfmode" ) == 0 && i + 1 < argc ){
+            i++;
+            if( strcmp( argv[i], "exact" ) == 0 )
+                gpOptions.hfMode = HF_EXACT;
+            else if( strcmp( argv[i], "skip" ) == 0 )
+                gpOptions.hfMode = HF_SKIP;
+            else if( strcmp( argv[i], "b2b" ) == 0 )
+                gpOptions.hfMode = HF_B2B;
+            else if( strcmp( argv[i], "lazy" ) == 0 )
+                gpOptions.hfMode = HF_LAZY;
+            else{
+                cout << "Unknown high-fanout mode: " << argv[i] << " (exact|skip|b2b|lazy)" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( argv[i]+1, "hfthreshold" ) == 0 && i + 1 < argc ){
+            gpOptions.hfThreshold = max( 0, atoi( argv[++i] ) );
+        }
+        else if( strcmp( argv[i]+1, "hfperiod" ) == 0 && i + 1 < argc ){
+            gpOptions.hfPeriod = max( 1, atoi( argv[++i] ) );
+        }
+        else if( strcmp( argv[i]+1, "incremental" ) == 0 && i + 1 < argc ){
+            gpOptions.wlIncrementalTol = atof( argv[++i] );
+        }
+        else if( strcmp( argv[i]+1, "precision" ) == 0 && i + 1 < argc ){
+            i++;
+            if( strcmp( argv[i], "double" ) == 0 )
+                gpOptions.singlePrecision = false;
+            else if( strcmp( argv[i], "float" ) == 0 )
+                gpOptions.singlePrecision = true;
+            else{
+                cout << "Unknown precision: " << argv[i] << " (float|double)" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( argv[i]+1, "density" ) == 0 && i + 1 < argc ){
+            i++;
+            if( strcmp( argv[i], "bell" ) == 0 )
+                gpOptions.densityModel = DENSITY_BELL;
+            else if( strcmp( argv[i], "bellexact" ) == 0 )
+                gpOptions.densityModel = DENSITY_BELL_EXACT;
+            else if( strcmp( argv[i], "eplace" ) == 0 )
+                gpOptions.densityModel = DENSITY_ELECTROSTATIC;
+            else{
+                cout << "Unknown density model: " << argv[i] << " (bell|bellexact|eplace)" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( argv[i]+1, "bins" ) == 0 && i + 1 < argc ){
+            gpOptions.densityBins = max( 1, atoi( argv[++i] ) );
+        }
+        else if( strcmp( argv[i]+1, "overflow" ) == 0 && i + 1 < argc ){
+            gpOptions.targetOverflow = atof( argv[++i] );
+        }
+        else if( strcmp( argv[i]+1, "multilevel" ) == 0 ){
+            gpOptions.multiLevel = true;
+        }
+        else if( strcmp( argv[i]+1, "optimizer" ) == 0 && i + 1 < argc ){
+            i++;
+            if( strcmp( argv[i], "cg" ) == 0 )
+                gpOptions.optimizer = OPTIMIZER_CG;
+            else if( strcmp( argv[i], "nesterov" ) == 0 )
+                gpOptions.optimizer = OPTIMIZER_NESTEROV;
+            else if( strcmp( argv[i], "lbfgs" ) == 0 )
+                gpOptions.optimizer = OPTIMIZER_LBFGS;
+            else{
+                cout << "Unknown optimizer: " << argv[i] << " (cg|nesterov|lbfgs)" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( argv[i]+1, "precondition" ) == 0 ){
+            gpOptions.precondition = true;
+        }
+        else if( strcmp( argv[i]+1, "box" ) == 0 ){
+            gpOptions.boxConstraint = true;
+        }
+        else if( strcmp( argv[i]+1, "nobox" ) == 0 ){
+            gpOptions.boxConstraint = false;
+        }
+        else if( strcmp( argv[i]+1, "history" ) == 0 && i + 1 < argc ){
+            gpOptions.lbfgsHistory = max( 1, atoi( argv[++i] ) );
+        }
+        else if( strcmp( argv[i]+1, "stepsize" ) == 0 && i + 1 < argc ){
+            i++;
+            if( strcmp( argv[i], "norm" ) == 0 )
+                gpOptions.stepSize = STEP_NORM;
+            else if( strcmp( argv[i], "armijo" ) == 0 )
+                gpOptions.stepSize = STEP_ARMIJO;
+            else if( strcmp( argv[i], "lipschitz" ) == 0 )
+                gpOptions.stepSize = STEP_LIPSCHITZ;
+            else{
+                cout << "Unknown step-size rule: " << argv[i] << " (norm|armijo|lipschitz)" << endl;
+                return false;
+            }
+        }
+        else if( strcmp( argv[i]+1, "trace" ) == 0 && i + 1 < argc ){
+            gpOptions.traceFile = string( argv[++i] );
+        }
+        else if( strcmp( argv[i]+1, "traceevery" ) == 0 && i + 1 < argc ){
+            gpOptions.traceEvery = max( 1, atoi( argv[++i] ) );
+        }
+        else if( strcmp( argv[i]+1, "plotevery" ) == 0 && i + 1 < argc ){
+            gpOptions.plotEvery = max( 0, atoi( argv[++i] ) );
+        }
+        else if( strcmp( argv[i]+1, "seed" ) == 0 && i + 1 < argc ){
+            gpOptions.seed = atol( argv[++i] );
+        }
         i++;
     }
     return true;
@@ -55,7 +165,8 @@ int main(int argc, char *argv[])
     
 	
 	gArg.Init( argc, argv );
-    if( !handleArgument( argc, argv, param ) )
+    GlobalPlacerOptions gpOptions;
+    if( !handleArgument( argc, argv, param, gpOptions ) )
         return -1;
 
 
@@ -96,7 +207,7 @@ int main(int argc, char *argv[])
 		
         ////////////start to edit your code /////////////
 		
-		GlobalPlacer globalPlacer(placement);
+		GlobalPlacer globalPlacer(placement, gpOptions);
 		globalPlacer.place(0);
 		globalPlacer.plotPlacementResult( "init.plt" );
 
@@ -132,7 +243,7 @@ int main(int argc, char *argv[])
         else
         {
             cout<<"legalization fail! Try random global placement. "<<endl;
-            GlobalPlacer replace(placement);
+            GlobalPlacer replace(placement, gpOptions);
             replace.place(1);
             placement.outputBookshelfFormat(placement.name()+".gp.pl");
             orig_wirelength = placement.computeHpwl();
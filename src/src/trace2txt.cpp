@@ -0,0 +1,56 @@
+/**
+ * @brief Convert a binary optimizer trace (-trace) to the text layout of grad_vectors.txt
+ *
+ * Usage: trace2txt <trace> [out_dir]
+ *
+ * Writes <out_dir>/grad_vectors_<step>.txt for every frame and <out_dir>/grad_vectors.txt for
+ * the last one (default out_dir: plot_output). Every line is "x y -gx -gy |g|" for one module,
+ * i.e. the position and the descent direction of the module at that step.
+ */
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "TraceWriter.h"
+
+static void writeFrame(const std::string &filename, const std::vector<float> &data) {
+    std::ofstream out(filename);
+    for (size_t k = 0; k + 4 <= data.size(); k += 4) {
+        const double x = data[k], y = data[k + 1], gx = data[k + 2], gy = data[k + 3];
+        out << x << " " << y << " " << -gx << " " << -gy << " " << std::sqrt(gx * gx + gy * gy) << "\n";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        printf("Usage: %s <trace> [out_dir]\n", argv[0]);
+        return 1;
+    }
+    const std::string out_dir = argc > 2 ? argv[2] : "plot_output";
+
+    TraceReader reader(argv[1]);
+    if (!reader.isValid()) {
+        printf("ERROR: %s is not a trace file.\n", argv[1]);
+        return 1;
+    }
+
+    uint64_t step, last_step = 0;
+    std::vector<float> data, last;
+    size_t num_frames = 0;
+    while (reader.next(step, data)) {
+        writeFrame(out_dir + "/grad_vectors_" + std::to_string(step) + ".txt", data);
+        last.swap(data);
+        last_step = step;
+        ++num_frames;
+    }
+    if (num_frames == 0) {
+        printf("ERROR: %s has no frames.\n", argv[1]);
+        return 1;
+    }
+    writeFrame(out_dir + "/grad_vectors.txt", last);
+    printf("INFO: wrote %zu frame(s) to %s, the last one (step %llu) also as grad_vectors.txt.\n", num_frames, out_dir.c_str(),
+           (unsigned long long)last_step);
+    return 0;
+}
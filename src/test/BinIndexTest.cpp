@@ -0,0 +1,96 @@
+#include "PlacementTestUtil.h"
+
+#include <algorithm>
+
+#include "BinIndex.h"
+
+/**
+ * @brief Checks of the bin index the bell-shaped density keeps
+ *
+ * After a forward pass at random positions, compares every bin's module list and the
+ * result of 200 random region queries with a brute-force scan of all modules.
+ *
+ * Usage: bin_index_test [benchmark.aux]
+ */
+
+namespace {
+
+// Bin of a coordinate, clamped to the grid, computed without the index
+int binOf(double v, double lo, double size, int count) {
+    return std::min(std::max((int)std::floor((v - lo) / size), 0), count - 1);
+}
+
+void testBinIndex(const FlatNetlist &netlist, int rows, int cols) {
+    const std::vector<Point2<double>> pos = randomPositions<double>(netlist, 5);
+    Density<double> density(netlist, rows, cols, 0.9);
+    density(pos);
+    const BinIndex &index = density.getBinIndex();
+    const double left = netlist.boundryLeft(), bottom = netlist.boundryBottom();
+    const double width = netlist.boundryRight() - left, height = netlist.boundryTop() - bottom;
+    const double bin_width = width / cols, bin_height = height / rows;
+
+    // Every bin lists exactly its movable modules, in ascending order
+    std::vector<std::vector<size_t>> expected(size_t(rows) * cols);
+    size_t num_movable = 0;
+    for (size_t i = 0; i < pos.size(); ++i) {
+        if (netlist.isFixed(i)) continue;
+        expected[size_t(binOf(pos[i].y, bottom, bin_height, rows)) * cols + binOf(pos[i].x, left, bin_width, cols)].push_back(i);
+        ++num_movable;
+    }
+    check(index.numModules() == num_movable, "indexed modules", index.numModules(), num_movable);
+    size_t wrong_bins = 0;
+    for (int by = 0; by < rows; ++by) {
+        for (int bx = 0; bx < cols; ++bx) {
+            const std::vector<size_t> listed(index.begin(by, bx), index.end(by, bx));
+            if (listed != expected[size_t(by) * cols + bx]) ++wrong_bins;
+        }
+    }
+    check(wrong_bins == 0, "bins whose module list differs from a full scan", wrong_bins, 0);
+
+    // Region queries, some reaching past the region: the bins overlapping the query, and so
+    // every module whose center lies inside it
+    std::mt19937 gen(6);
+    std::uniform_real_distribution<> dis_x(left - 0.1 * width, left + 1.1 * width);
+    std::uniform_real_distribution<> dis_y(bottom - 0.1 * height, bottom + 1.1 * height);
+    size_t wrong_queries = 0, missed = 0;
+    for (int q = 0; q < 200; ++q) {
+        double x0 = dis_x(gen), x1 = dis_x(gen), y0 = dis_y(gen), y1 = dis_y(gen);
+        if (x0 > x1) std::swap(x0, x1);
+        if (y0 > y1) std::swap(y0, y1);
+        if (q % 4 == 0) x1 = x0 + 0.5 * bin_width, y1 = y0 + 0.5 * bin_height;  // Within one or two bins
+
+        std::vector<size_t> visited;
+        index.forEachModule(x0, y0, x1, y1, [&](size_t i) { visited.push_back(i); });
+        std::sort(visited.begin(), visited.end());
+
+        const int bx0 = binOf(x0, left, bin_width, cols), bx1 = binOf(x1, left, bin_width, cols);
+        const int by0 = binOf(y0, bottom, bin_height, rows), by1 = binOf(y1, bottom, bin_height, rows);
+        std::vector<size_t> brute;
+        for (size_t i = 0; i < pos.size(); ++i) {
+            if (netlist.isFixed(i)) continue;
+            const int bx = binOf(pos[i].x, left, bin_width, cols), by = binOf(pos[i].y, bottom, bin_height, rows);
+            if (bx >= bx0 && bx <= bx1 && by >= by0 && by <= by1) brute.push_back(i);
+            const bool inside = pos[i].x >= x0 && pos[i].x <= x1 && pos[i].y >= y0 && pos[i].y <= y1;
+            if (inside && !std::binary_search(visited.begin(), visited.end(), i)) ++missed;
+        }
+        if (visited != brute) ++wrong_queries;
+    }
+    check(wrong_queries == 0, "region queries that differ from a full scan", wrong_queries, 0);
+    check(missed == 0, "modules inside a query region that were not visited", missed, 0);
+    printf("Bin index, %d x %d bins: %zu modules, 200 region queries checked\n", rows, cols, num_movable);
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    const std::string aux = benchmarkPath(argc, argv);
+    Placement placement;
+    placement.readBookshelfFormat(aux, "");
+    FlatNetlist netlist(placement);
+    printf("%s: %zu modules, %zu nets\n", aux.c_str(), netlist.numModules(), netlist.numNets());
+
+    testBinIndex(netlist, 64, 64);
+    testBinIndex(netlist, 37, 53);
+
+    return finish();
+}
@@ -0,0 +1,189 @@
+#include "PlacementTestUtil.h"
+#include "ThreadPool.h"
+
+/**
+ * @brief Checks of the density models
+ *
+ * Compares the analytic gradient of the squared-overflow bell penalty, and the field of the
+ * electrostatic density, with central differences of their values on a real benchmark,
+ * checks that both bell penalties spread a pile of modules, the float32 bell grids against
+ * double, and that modules off the region count in the overflow of both density models.
+ *
+ * Usage: density_test [benchmark.aux]
+ */
+
+namespace {
+
+// The squared-overflow penalty, whose gradient is the derivative of its value
+void testDensityFiniteDifferences(const FlatNetlist &netlist) {
+    const std::vector<size_t> sample = sampleModules(netlist, 40);
+    const std::vector<Point2<double>> pos = randomPositions<double>(netlist, 3);
+    const double bin_width = (netlist.boundryRight() - netlist.boundryLeft()) / 64;
+
+    // Random positions overflow some bins but not all, so both sides of the penalty are hit
+    ThreadPool pool(4);
+    Density<double> density(netlist, /*bin_rows=*/64, /*bin_cols=*/64, /*target_density=*/0.9);
+    density.setPenalty(PENALTY_OVERFLOW);
+    density.setThreadPool(&pool);
+    density(pos);
+    check(density.getOverflow() > 0.0, "overflow of the density test positions", density.getOverflow(), 0.0);
+    checkFiniteDifferences("Bell-shaped density, squared overflow", density, pos, sample, 1e-4 * bin_width, 1e-4);
+
+    // The same for a grid fine enough that modules span several bins
+    Density<double> fine(netlist, 256, 256, 0.9);
+    fine.setPenalty(PENALTY_OVERFLOW);
+    checkFiniteDifferences("Bell-shaped density, squared overflow, 256 x 256 bins", fine, pos, sample, 1e-5 * bin_width, 1e-4);
+}
+
+/**
+ * @brief Electrostatic field against central differences of the energy
+ *
+ * The field is the derivative of the continuous cosine series of the potential, sampled at
+ * the bin centers, and not the derivative of the discrete energy, so single partial
+ * derivatives differ by up to about half on coarse grids. What has to hold is that the two
+ * point the same way over many modules and have about the same length. Modules whose
+ * footprint reaches past the region are shifted inside it, so that small moves do not change
+ * the energy at all; they are left out.
+ */
+void testElectrostaticFiniteDifferences(const FlatNetlist &netlist, int bins, double min_cosine) {
+    const std::vector<Point2<double>> pos = randomPositions<double>(netlist, 3);
+    const double bin_width = (netlist.boundryRight() - netlist.boundryLeft()) / bins;
+    const double bin_height = (netlist.boundryTop() - netlist.boundryBottom()) / bins;
+    std::vector<size_t> sample;
+    for (size_t i : sampleModules(netlist, 200)) {
+        const double half_w = std::max(netlist.width(i), std::sqrt(2.0) * bin_width) / 2 + bin_width;
+        const double half_h = std::max(netlist.height(i), std::sqrt(2.0) * bin_height) / 2 + bin_height;
+        if (pos[i].x - half_w > netlist.boundryLeft() && pos[i].x + half_w < netlist.boundryRight() &&
+            pos[i].y - half_h > netlist.boundryBottom() && pos[i].y + half_h < netlist.boundryTop()) {
+            sample.push_back(i);
+        }
+    }
+
+    ElectrostaticDensity<double> density(netlist, bins, bins, 0.9);
+    std::vector<Point2<double>> moved = pos;
+    density.ForwardBackward(moved);
+    const std::vector<Point2<double>> grad = density.grad();
+    const double h = 1e-3 * bin_width;
+    double dot = 0.0, grad_sq = 0.0, fd_sq = 0.0;
+    for (size_t i : sample) {
+        for (int axis = 0; axis < 2; ++axis) {
+            double &coord = axis == 0 ? moved[i].x : moved[i].y;
+            coord = (axis == 0 ? pos[i].x : pos[i].y) + h;
+            const double f_plus = density(moved);
+            coord -= 2 * h;
+            const double f_minus = density(moved);
+            coord += h;
+            const double fd = (f_plus - f_minus) / (2 * h);
+            const double analytic = axis == 0 ? grad[i].x : grad[i].y;
+            dot += fd * analytic;
+            grad_sq += analytic * analytic;
+            fd_sq += fd * fd;
+        }
+    }
+    const double cosine = dot / std::sqrt(grad_sq * fd_sq);
+    const double ratio = std::sqrt(grad_sq / fd_sq);
+    std::string name = "Electrostatic density, " + std::to_string(bins) + " x " + std::to_string(bins) + " bins";
+    check(cosine >= min_cosine, (name + ": cosine of field and differences").c_str(), cosine, min_cosine);
+    check(ratio > 0.8 && ratio < 1.25, (name + ": field over differences in length").c_str(), ratio, 1.0);
+    printf("%s: %zu modules, cosine %.4f of the field and central differences, length ratio %.3f\n",
+           name.c_str(), sample.size(), cosine, ratio);
+}
+
+/**
+ * @brief Both penalties push the modules of a pile outwards
+ *
+ * The field penalty has no value to difference, so its gradient is checked by what it is
+ * for: with the movable modules piled up around the center of the region, the descent
+ * direction of the modules away from the middle of the pile points away from it.
+ */
+void testDensityPile(const FlatNetlist &netlist, DensityPenalty penalty, const char *name) {
+    const double width = netlist.boundryRight() - netlist.boundryLeft();
+    const double height = netlist.boundryTop() - netlist.boundryBottom();
+    const Point2<double> center(netlist.boundryLeft() + width / 2, netlist.boundryBottom() + height / 2);
+    std::mt19937 gen(5);
+    std::normal_distribution<> dis_x(center.x, width / 16), dis_y(center.y, height / 16);
+    std::vector<Point2<double>> pos(netlist.numModules());
+    for (size_t i = 0; i < pos.size(); ++i) {
+        if (!netlist.isFixed(i)) pos[i] = Point2<double>(dis_x(gen), dis_y(gen));
+    }
+
+    Density<double> density(netlist, 64, 64, 0.9);
+    density.setPenalty(penalty);
+    density.ForwardBackward(pos);
+    size_t checked = 0, inward = 0;
+    for (size_t i = 0; i < pos.size(); ++i) {
+        const Point2<double> d = pos[i] - center;
+        if (netlist.isFixed(i) || std::abs(d.x) < width / 16 || std::abs(d.y) < height / 16) continue;
+        const Point2<double> &g = density.grad()[i];
+        ++checked;
+        if (g.x * d.x + g.y * d.y >= 0.0) ++inward;
+    }
+    check(checked > 0 && inward <= checked / 100, (std::string(name) + ": modules off the middle of a pile pushed inwards").c_str(),
+          inward, 0);
+    printf("%s: %zu / %zu modules off the middle of a pile pushed outwards\n", name, checked - inward, checked);
+}
+
+// float32 grids: close to double
+void testDensityFloat(const FlatNetlist &netlist, DensityPenalty penalty, const char *name) {
+    const std::vector<Point2<double>> pos = randomPositions<double>(netlist, 3);
+    std::vector<Point2<float>> pos_f(pos.size());
+    for (size_t i = 0; i < pos.size(); ++i) pos_f[i] = Point2<float>(pos[i].x, pos[i].y);
+
+    Density<double> reference(netlist, 64, 64, 0.9);
+    reference.setPenalty(penalty);
+    reference.ForwardBackward(pos);
+    Density<float> single(netlist, 64, 64, 0.9);
+    single.setPenalty(penalty);
+    single.ForwardBackward(pos_f);
+    const std::string prefix = std::string("float32 ") + name;
+    check(close(single.value(), reference.value(), 1e-4, 0.0), (prefix + " value").c_str(), single.value(), reference.value());
+    double grad_scale = 0.0, grad_err = 0.0;
+    for (size_t i = 0; i < pos.size(); ++i) {
+        const Point2<double> &g = reference.grad()[i];
+        grad_scale = std::max(grad_scale, std::abs(g.x) + std::abs(g.y));
+        grad_err = std::max(grad_err, std::abs(single.grad()[i].x - g.x) + std::abs(single.grad()[i].y - g.y));
+    }
+    check(grad_err <= 1e-3 * grad_scale, (prefix + " gradient error").c_str(), grad_err, 0.0);
+    printf("%s: float32 pass, value error %.2e, gradient error %.2e of the largest\n", name,
+           std::abs(single.value() - reference.value()) / reference.value(), grad_err / grad_scale);
+}
+
+// Modules pushed off the region still count in the overflow, at the nearest edge bins
+void testDensityOffRegion(const FlatNetlist &netlist) {
+    std::vector<Point2<double>> pos = randomPositions<double>(netlist, 4);
+    const double width = netlist.boundryRight() - netlist.boundryLeft();
+    for (size_t i = 0; i < pos.size(); ++i) {
+        if (!netlist.isFixed(i) && i % 2 == 0) pos[i].x = netlist.boundryLeft() - width;
+    }
+
+    Density<double> bell(netlist, 64, 64, 0.9);
+    bell(pos);
+    check(bell.getOverflow() > 0.4, "bell overflow with half the modules off the region", bell.getOverflow(), 0.4);
+    ElectrostaticDensity<double> electrostatic(netlist, 64, 64, 0.9);
+    electrostatic(pos);
+    check(electrostatic.getOverflow() > 0.4, "electrostatic overflow with half the modules off the region",
+          electrostatic.getOverflow(), 0.4);
+    printf("Density: overflow %.3f (bell), %.3f (electrostatic) with half the modules off the region\n",
+           bell.getOverflow(), electrostatic.getOverflow());
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    const std::string aux = benchmarkPath(argc, argv);
+    Placement placement;
+    placement.readBookshelfFormat(aux, "");
+    FlatNetlist netlist(placement);
+    printf("%s: %zu modules, %zu nets\n", aux.c_str(), netlist.numModules(), netlist.numNets());
+
+    testDensityFiniteDifferences(netlist);
+    testElectrostaticFiniteDifferences(netlist, 64, 0.9);
+    testElectrostaticFiniteDifferences(netlist, 256, 0.98);
+    testDensityPile(netlist, PENALTY_FIELD, "Bell-shaped density, field");
+    testDensityPile(netlist, PENALTY_OVERFLOW, "Bell-shaped density, squared overflow");
+    testDensityFloat(netlist, PENALTY_FIELD, "Bell-shaped density, field");
+    testDensityFloat(netlist, PENALTY_OVERFLOW, "Bell-shaped density, squared overflow");
+    testDensityOffRegion(netlist);
+
+    return finish();
+}
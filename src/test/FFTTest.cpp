@@ -0,0 +1,127 @@
+#include <cmath>
+#include <complex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "FFT.h"
+#include "TestUtil.h"
+
+/**
+ * @brief Checks of the FFT-based transforms of the electrostatic density
+ *
+ * Compares the complex FFT and the cosine and sine transforms with their O(n^2) definitions
+ * for every power-of-two length up to 512, and checks that the DCT-II and DCT-III, and the
+ * sine transform and its direct inverse, undo each other.
+ *
+ * Usage: fft_test
+ */
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Largest |a - b| over the largest |b|
+double relativeError(const std::vector<double> &a, const std::vector<double> &b) {
+    double err = 0.0, scale = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        err = std::max(err, std::abs(a[i] - b[i]));
+        scale = std::max(scale, std::abs(b[i]));
+    }
+    return err / std::max(scale, 1e-300);
+}
+
+// Direct sums of the definitions in FFT.h
+std::vector<double> directDct(const std::vector<double> &x) {
+    const size_t n = x.size();
+    std::vector<double> out(n, 0.0);
+    for (size_t u = 0; u < n; ++u) {
+        for (size_t k = 0; k < n; ++k) out[u] += x[k] * std::cos(kPi * u * (k + 0.5) / n);
+    }
+    return out;
+}
+
+std::vector<double> directIdct(const std::vector<double> &a) {
+    const size_t n = a.size();
+    std::vector<double> out(n, 0.0);
+    for (size_t k = 0; k < n; ++k) {
+        for (size_t u = 0; u < n; ++u) out[k] += a[u] * std::cos(kPi * u * (k + 0.5) / n);
+    }
+    return out;
+}
+
+std::vector<double> directIdst(const std::vector<double> &a) {
+    const size_t n = a.size();
+    std::vector<double> out(n, 0.0);
+    for (size_t k = 0; k < n; ++k) {
+        for (size_t u = 0; u < n; ++u) out[k] += a[u] * std::sin(kPi * u * (k + 0.5) / n);
+    }
+    return out;
+}
+
+void testTransforms(size_t n, std::mt19937 &gen) {
+    std::uniform_real_distribution<> dis(-1.0, 1.0);
+    std::vector<double> x(n), out(n);
+    for (double &v : x) v = dis(gen);
+    FFT fft(n);
+    const std::string len = " of length " + std::to_string(n);
+    const double tol = 1e-12;
+
+    // Complex FFT and its inverse
+    std::vector<std::complex<double>> data(n), spectrum(n);
+    for (size_t k = 0; k < n; ++k) data[k] = std::complex<double>(x[k], dis(gen));
+    for (size_t u = 0; u < n; ++u) {
+        for (size_t k = 0; k < n; ++k) spectrum[u] += data[k] * std::polar(1.0, -2 * kPi * double(u * k % n) / n);
+    }
+    std::vector<std::complex<double>> result = data;
+    fft.transform(result.data(), false);
+    double err = 0.0, scale = 0.0;
+    for (size_t u = 0; u < n; ++u) {
+        err = std::max(err, std::abs(result[u] - spectrum[u]));
+        scale = std::max(scale, std::abs(spectrum[u]));
+    }
+    check(err <= tol * scale, ("FFT" + len).c_str(), err / scale, 0.0);
+    fft.transform(result.data(), true);
+    err = 0.0;
+    for (size_t k = 0; k < n; ++k) err = std::max(err, std::abs(result[k] / double(n) - data[k]));
+    check(err <= tol, ("FFT and inverse" + len).c_str(), err, 0.0);
+
+    // Each real transform against its definition, in place
+    out = x;
+    fft.dct(out.data(), out.data());
+    const std::vector<double> coeff = out;
+    check(relativeError(out, directDct(x)) <= tol, ("DCT-II" + len).c_str(), relativeError(out, directDct(x)), 0.0);
+    fft.idct(x.data(), out.data());
+    check(relativeError(out, directIdct(x)) <= tol, ("DCT-III" + len).c_str(), relativeError(out, directIdct(x)), 0.0);
+    fft.idst(x.data(), out.data());
+    check(relativeError(out, directIdst(x)) <= tol, ("inverse DST" + len).c_str(), relativeError(out, directIdst(x)), 0.0);
+
+    // DCT-III after DCT-II, with the constant term halved, is n / 2 times the identity
+    std::vector<double> half = coeff;
+    half[0] /= 2;
+    fft.idct(half.data(), out.data());
+    for (double &v : out) v *= 2.0 / n;
+    check(relativeError(out, x) <= tol, ("DCT-II and DCT-III round trip" + len).c_str(), relativeError(out, x), 0.0);
+
+    // The sines of u = 1 .. n - 1 are orthogonal with norm n / 2 over the n sample points, so
+    // coefficients without a constant term come back from the samples of idst()
+    std::vector<double> sines = x;
+    sines[0] = 0.0;
+    std::vector<double> samples(n), back(n, 0.0);
+    fft.idst(sines.data(), samples.data());
+    for (size_t u = 1; u < n; ++u) {
+        for (size_t k = 0; k < n; ++k) back[u] += samples[k] * std::sin(kPi * u * (k + 0.5) / n) * 2.0 / n;
+    }
+    check(relativeError(back, sines) <= tol, ("inverse DST round trip" + len).c_str(), relativeError(back, sines), 0.0);
+}
+
+}  // namespace
+
+int main() {
+    std::mt19937 gen(1);
+    for (size_t n = 1; n <= 512; n *= 2) testTransforms(n, gen);
+    check(FFT::roundUp(1) == 1 && FFT::roundUp(100) == 128 && FFT::roundUp(128) == 128, "FFT::roundUp(100)",
+          FFT::roundUp(100), 128);
+    printf("FFT, DCT-II, DCT-III and inverse DST checked for lengths 1 to 512\n");
+    return finish();
+}
@@ -0,0 +1,94 @@
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "FastExp.h"
+#include "TestUtil.h"
+
+/**
+ * @brief Checks of the batched exponential against std::exp
+ *
+ * Runs every kernel this CPU supports, and the dispatched fastExp(), over random arguments
+ * in [-708, 709] and the edges of the range, and checks the accuracy documented in
+ * FastExp.h: at most 1 ulp from std::exp inside the range, 0 below -708 and +inf above 709.
+ * Batch lengths that are not a multiple of the vector width, and in-place calls, are covered
+ * as well.
+ *
+ * Usage: fastexp_test [samples]
+ */
+
+namespace {
+
+// Distance in representable doubles between two non-negative doubles
+uint64_t ulpDistance(double a, double b) {
+    uint64_t ia, ib;
+    std::memcpy(&ia, &a, sizeof(a));
+    std::memcpy(&ib, &b, sizeof(b));
+    return ia > ib ? ia - ib : ib - ia;
+}
+
+void testKernel(const char *name, FastExpKernel kernel, size_t samples) {
+    const std::string prefix = std::string("fastExp (") + name + ")";
+
+    // Random arguments over the whole accurate range
+    std::mt19937_64 gen(1);
+    std::uniform_real_distribution<> dis(-708.0, 709.0);
+    std::vector<double> in(samples), out(samples);
+    for (double &x : in) x = dis(gen);
+    kernel(in.data(), out.data(), samples);
+    uint64_t worst = 0;
+    double worst_x = 0.0;
+    for (size_t i = 0; i < samples; ++i) {
+        const uint64_t d = ulpDistance(out[i], std::exp(in[i]));
+        if (d > worst) worst = d, worst_x = in[i];
+    }
+    check(worst <= 1, (prefix + ": largest error in ulp, at x = " + std::to_string(worst_x)).c_str(), worst, 1);
+
+    // Edges of the range: exact at 0, accurate at the ends, 0 below and +inf above
+    const double inf = std::numeric_limits<double>::infinity();
+    const std::vector<double> edges = {0.0, -708.0, 709.0, 1e-300, -1e-300, -708.0000001, -745.2, -1e4, -inf,
+                                       709.0000001, 710.0, 1e4, inf};
+    std::vector<double> edge_out(edges.size());
+    kernel(edges.data(), edge_out.data(), edges.size());
+    for (size_t i = 0; i < edges.size(); ++i) {
+        const std::string what = prefix + " of " + std::to_string(edges[i]);
+        if (edges[i] < -708.0) {
+            check(edge_out[i] == 0.0, what.c_str(), edge_out[i], 0.0);
+        } else if (edges[i] > 709.0) {
+            check(edge_out[i] == inf, what.c_str(), edge_out[i], inf);
+        } else {
+            check(ulpDistance(edge_out[i], std::exp(edges[i])) <= 1, what.c_str(), edge_out[i], std::exp(edges[i]));
+        }
+    }
+
+    // Every tail length, in place
+    for (size_t n = 1; n <= 17; ++n) {
+        std::vector<double> data(in.begin(), in.begin() + n);
+        kernel(data.data(), data.data(), n);
+        size_t wrong = 0;
+        for (size_t i = 0; i < n; ++i) wrong += data[i] != out[i];
+        check(wrong == 0, (prefix + ", in place, values that differ in a batch of " + std::to_string(n)).c_str(),
+              wrong, 0);
+    }
+    printf("%s: %zu samples, largest error %llu ulp\n", prefix.c_str(), samples, (unsigned long long)worst);
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    const size_t samples = argc > 1 ? std::stoul(argv[1]) : 10000000;
+    for (const char *isa : {"avx512", "avx2", "scalar"}) {
+        FastExpKernel kernel = fastExpKernel(isa);
+        if (kernel) {
+            testKernel(isa, kernel, samples);
+        } else {
+            printf("fastExp (%s): not supported by this CPU, skipped\n", isa);
+        }
+    }
+    testKernel((std::string("dispatched, ") + fastExpIsa()).c_str(), fastExp, samples);
+    return finish();
+}
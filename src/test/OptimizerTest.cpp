@@ -0,0 +1,137 @@
+#define _GLIBCXX_USE_CXX11_ABI 0  // Align the ABI version to avoid compatibility issues with `Placment.h`
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Optimizer.h"
+#include "TestUtil.h"
+
+/**
+ * @brief Checks of the optimizers on a separable quadratic
+ *
+ * The quadratic can be made to report the negated gradient at one evaluation, which turns
+ * the next search direction uphill and makes its Armijo search fail. A failed search must
+ * leave the positions bit for bit where they were.
+ *
+ * Usage: optimizer_test
+ */
+
+namespace {
+
+constexpr double kRegion = 1000.0;  // The region is [0, kRegion]^2
+
+/**
+ * @brief f(x) = sum_i a_i |x_i - c_i|^2 with curvatures a_i over three orders of magnitude
+ */
+class Quadratic : public BaseFunction<double> {
+   public:
+    explicit Quadratic(size_t n) : BaseFunction<double>(n), a_(n), c_(n) {
+        std::mt19937 gen(7);
+        std::uniform_real_distribution<> curvature(0.0, 3.0), center(0.2 * kRegion, 0.8 * kRegion);
+        for (size_t i = 0; i < n; ++i) {
+            a_[i] = std::pow(10.0, curvature(gen));
+            c_[i] = Point2<double>(center(gen), center(gen));
+        }
+    }
+
+    // The gradient of the backward pass number k (from 0) comes out negated
+    void negateGradientAt(size_t k) { negate_at_ = k; }
+    size_t numBackward() const { return num_backward_; }
+
+    const double &operator()(const std::vector<Point2<double>> &input) override {
+        input_ = &input;
+        value_ = 0.0;
+        for (size_t i = 0; i < input.size(); ++i) {
+            const Point2<double> d = input[i] - c_[i];
+            value_ += a_[i] * (d.x * d.x + d.y * d.y);
+        }
+        return value_;
+    }
+
+    const std::vector<Point2<double>> &Backward() override {
+        const double sign = num_backward_++ == negate_at_ ? -1.0 : 1.0;
+        for (size_t i = 0; i < grad_.size(); ++i) {
+            grad_[i] = ((*input_)[i] - c_[i]) * (2.0 * a_[i] * sign);
+        }
+        return grad_;
+    }
+
+   private:
+    std::vector<double> a_;
+    std::vector<Point2<double>> c_;
+    const std::vector<Point2<double>> *input_ = nullptr;
+    size_t negate_at_ = size_t(-1);
+    size_t num_backward_ = 0;
+};
+
+std::vector<Point2<double>> startPositions(size_t n) {
+    std::mt19937 gen(8);
+    std::uniform_real_distribution<> dis(0.0, kRegion);
+    std::vector<Point2<double>> pos(n);
+    for (auto &p : pos) p = Point2<double>(dis(gen), dis(gen));
+    return pos;
+}
+
+bool identical(const std::vector<Point2<double>> &a, const std::vector<Point2<double>> &b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(a[0])) == 0;
+}
+
+// A failed Armijo search of the conjugate gradient keeps var_, and the next step recovers
+void testConjugateGradientFailedSearch() {
+    const size_t n = 500;
+    Quadratic f(n);
+    std::vector<Point2<double>> var = startPositions(n);
+    SimpleConjugateGradient<double> cg(f, var, 1.0, 0.0, kRegion, kRegion, 0.0);
+    cg.setStepSize(STEP_ARMIJO);
+    cg.Initialize();
+    f.negateGradientAt(3);
+
+    for (int k = 0; k < 3; ++k) cg.Step();
+    const std::vector<Point2<double>> before = var;
+    const double f_before = f(var);
+    cg.Step();  // Uphill: every trial increases f
+    check(identical(var, before), "conjugate gradient positions after a failed search are unchanged", f(var), f_before);
+
+    for (int k = 0; k < 30; ++k) cg.Step();
+    check(f(var) < 0.1 * f_before, "conjugate gradient decrease after a failed search", f(var), f_before);
+    printf("Conjugate gradient: failed Armijo search checked\n");
+}
+
+/**
+ * L-BFGS after a failed Armijo search: the positions are unchanged, the history is dropped,
+ * and the step after it, which starts where the failed one did, stores no curvature pair
+ */
+void testLBFGSFailedSearch() {
+    const size_t n = 500;
+    Quadratic f(n);
+    std::vector<Point2<double>> var = startPositions(n);
+    LBFGSOptimizer<double> lbfgs(f, var, 8, 0.0, kRegion, kRegion, 0.0);
+    lbfgs.Initialize();
+    f.negateGradientAt(4);
+
+    for (int k = 0; k < 4; ++k) lbfgs.Step();
+    check(lbfgs.numPairs() == 3, "L-BFGS pairs before the failed search", lbfgs.numPairs(), 3);
+    const std::vector<Point2<double>> before = var;
+    const double f_before = f(var);
+    lbfgs.Step();  // Uphill: every trial increases f
+    check(identical(var, before), "L-BFGS positions after a failed search are unchanged", f(var), f_before);
+    check(lbfgs.numPairs() == 0, "L-BFGS pairs after a failed search", lbfgs.numPairs(), 0);
+
+    lbfgs.Step();
+    check(lbfgs.numPairs() == 0, "L-BFGS pairs stored for a failed search", lbfgs.numPairs(), 0);
+    lbfgs.Step();
+    check(lbfgs.numPairs() == 1, "L-BFGS pairs one step after the failed search", lbfgs.numPairs(), 1);
+
+    for (int k = 0; k < 30; ++k) lbfgs.Step();
+    check(f(var) < 1e-2 * f_before, "L-BFGS decrease after a failed search", f(var), f_before);
+    printf("L-BFGS: failed Armijo search checked\n");
+}
+
+}  // namespace
+
+int main() {
+    testConjugateGradientFailedSearch();
+    testLBFGSFailedSearch();
+    return finish();
+}
@@ -0,0 +1,95 @@
+#define _GLIBCXX_USE_CXX11_ABI 0  // Align the ABI version to avoid compatibility issues with `Placment.h`
+#ifndef PLACEMENTTESTUTIL_H
+#define PLACEMENTTESTUTIL_H
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "FlatNetlist.h"
+#include "ObjectiveFunction.h"
+#include "Placement.h"
+#include "TestUtil.h"
+
+/**
+ * @brief Positions, samples and gradient checks on a real benchmark, for the tests of the
+ *        placement objective
+ */
+
+// Benchmark of a test program: its first argument, or ibm01 relative to src/
+inline std::string benchmarkPath(int argc, char *argv[]) {
+    return argc > 1 ? argv[1] : "benchmark/ibm01/ibm01-cu85.aux";
+}
+
+/**
+ * @brief Random movable positions over the region, with a few modules just inside or past
+ *        its edges
+ */
+template <typename T>
+std::vector<Point2<T>> randomPositions(const FlatNetlist &netlist, unsigned seed) {
+    std::mt19937 gen(seed);
+    const double left = netlist.boundryLeft(), right = netlist.boundryRight();
+    const double bottom = netlist.boundryBottom(), top = netlist.boundryTop();
+    std::uniform_real_distribution<> dis_x(left, right), dis_y(bottom, top);
+    std::vector<Point2<T>> pos(netlist.numModules());
+    for (size_t i = 0; i < pos.size(); ++i) {
+        if (netlist.isFixed(i)) continue;
+        pos[i] = Point2<T>(dis_x(gen), dis_y(gen));
+        switch (i % 97) {
+            case 0: pos[i].x = left + netlist.width(i) / 4; break;
+            case 1: pos[i].x = right + netlist.width(i) / 4; break;
+            case 2: pos[i].y = bottom - netlist.height(i) / 4; break;
+            case 3: pos[i].y = top - netlist.height(i) / 4; break;
+        }
+    }
+    return pos;
+}
+
+// Modules whose gradients are compared with central differences
+inline std::vector<size_t> sampleModules(const FlatNetlist &netlist, size_t count) {
+    std::vector<size_t> sample;
+    for (size_t i = 0; i < netlist.numModules() && sample.size() < count; i += 1 + netlist.numModules() / (2 * count)) {
+        if (!netlist.isFixed(i)) sample.push_back(i);
+    }
+    for (size_t i = 0; i < 4 && i < netlist.numModules(); ++i) {
+        if (!netlist.isFixed(i)) sample.push_back(i);  // The modules at the region edges
+    }
+    return sample;
+}
+
+/**
+ * @brief Central differences of f's value against f's gradient at pos, for every sampled
+ *        module and both coordinates, with steps of h
+ */
+inline void checkFiniteDifferences(const char *name, BaseFunction<double> &f, std::vector<Point2<double>> pos,
+                                   const std::vector<size_t> &sample, double h, double tol) {
+    f.ForwardBackward(pos);
+    const std::vector<Point2<double>> grad = f.grad();
+    double scale = 0.0;  // Largest sampled gradient component, the floor of the relative error
+    for (size_t i : sample) scale = std::max(scale, std::max(std::abs(grad[i].x), std::abs(grad[i].y)));
+
+    size_t checked = 0;
+    double worst = 0.0;
+    for (size_t i : sample) {
+        for (int axis = 0; axis < 2; ++axis) {
+            double &coord = axis == 0 ? pos[i].x : pos[i].y;
+            const double saved = coord;
+            coord = saved + h;
+            const double f_plus = f(pos);
+            coord = saved - h;
+            const double f_minus = f(pos);
+            coord = saved;
+
+            const double fd = (f_plus - f_minus) / (2 * h);
+            const double analytic = axis == 0 ? grad[i].x : grad[i].y;
+            const double err = std::abs(fd - analytic) / std::max(scale, 1e-300);
+            worst = std::max(worst, err);
+            std::string what = std::string(name) + " d/d" + (axis == 0 ? "x" : "y") + " of module " + std::to_string(i);
+            check(err <= tol, what.c_str(), analytic, fd);
+            ++checked;
+        }
+    }
+    printf("%s: %zu partial derivatives, largest error %.2e of the largest gradient\n", name, checked, worst);
+}
+
+#endif  // PLACEMENTTESTUTIL_H
@@ -0,0 +1,39 @@
+#ifndef TESTUTIL_H
+#define TESTUTIL_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+/**
+ * @brief Checks shared by the test programs
+ *
+ * A failed check prints what was compared and counts towards the exit status returned by
+ * finish(), so one run reports every failure instead of stopping at the first.
+ */
+
+inline int g_failures = 0;
+
+inline void check(bool ok, const char *what, double got, double expected) {
+    if (!ok) {
+        ++g_failures;
+        printf("FAIL: %s: got %.10g, expected %.10g\n", what, got, expected);
+    }
+}
+
+// |a - b| <= tol * max(|a|, |b|, floor)
+inline bool close(double a, double b, double tol, double floor) {
+    return std::abs(a - b) <= tol * std::max(std::max(std::abs(a), std::abs(b)), floor);
+}
+
+// Summary line and exit status of a test program
+inline int finish() {
+    if (g_failures > 0) {
+        printf("%d check(s) FAILED\n", g_failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
+
+#endif  // TESTUTIL_H
@@ -0,0 +1,141 @@
+#include "PlacementTestUtil.h"
+#include "ThreadPool.h"
+
+/**
+ * @brief Checks of the WA wirelength model
+ *
+ * Compares the analytic gradient with central differences of the value on a real benchmark,
+ * also with the high-fanout modes, and checks that the fused forward and backward pass
+ * matches the separate ones, does not depend on the number of threads and agrees with the
+ * incremental and float32 passes.
+ *
+ * Usage: wirelength_test [benchmark.aux]
+ */
+
+namespace {
+
+// Every degree bucket of the default model
+void testWirelengthFiniteDifferences(const FlatNetlist &netlist) {
+    const std::vector<size_t> sample = sampleModules(netlist, 40);
+    const std::vector<Point2<double>> pos = randomPositions<double>(netlist, 1);
+
+    Wirelength<double> wirelength(netlist, /*gamma=*/500.0);
+    checkFiniteDifferences("WA wirelength", wirelength, pos, sample, 0.5, 1e-6);
+}
+
+// High-fanout nets under the full WA model, and left out of both value and gradient
+void testWirelengthHighFanout(const FlatNetlist &netlist) {
+    const std::vector<size_t> sample = sampleModules(netlist, 40);
+    const std::vector<Point2<double>> pos = randomPositions<double>(netlist, 1);
+
+    Wirelength<double> wirelength(netlist, /*gamma=*/500.0);
+    wirelength.setHighFanout(HF_EXACT, 3);
+    checkFiniteDifferences("WA wirelength, high-fanout nets above 3 pins", wirelength, pos, sample, 0.5, 1e-6);
+    wirelength.setHighFanout(HF_SKIP, 3);
+    checkFiniteDifferences("WA wirelength, nets above 3 pins skipped", wirelength, pos, sample, 0.5, 1e-6);
+}
+
+// ForwardBackward() gives bit for bit the value of operator() and the gradient of Backward()
+void testWirelengthFused(const FlatNetlist &netlist) {
+    const std::vector<Point2<double>> pos = randomPositions<double>(netlist, 2);
+
+    Wirelength<double> reference(netlist, 500.0);
+    const double value = reference(pos);
+    const std::vector<Point2<double>> grad = reference.Backward();
+
+    Wirelength<double> fused(netlist, 500.0);
+    fused.ForwardBackward(pos);
+    check(fused.value() == value, "fused WA value", fused.value(), value);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < grad.size(); ++i) {
+        if (fused.grad()[i].x != grad[i].x || fused.grad()[i].y != grad[i].y) ++mismatches;
+    }
+    check(mismatches == 0, "fused WA gradients that differ", mismatches, 0);
+    printf("WA wirelength: fused pass checked\n");
+}
+
+// The result on four threads is bit-identical to the single-threaded one
+void testWirelengthThreads(const FlatNetlist &netlist) {
+    const std::vector<Point2<double>> pos = randomPositions<double>(netlist, 2);
+
+    Wirelength<double> reference(netlist, 500.0);
+    reference.ForwardBackward(pos);
+
+    ThreadPool pool(4);
+    Wirelength<double> threaded(netlist, 500.0);
+    threaded.setThreadPool(&pool);
+    threaded.ForwardBackward(pos);
+    check(threaded.value() == reference.value(), "threaded WA value", threaded.value(), reference.value());
+    size_t mismatches = 0;
+    for (size_t i = 0; i < pos.size(); ++i) {
+        if (threaded.grad()[i].x != reference.grad()[i].x || threaded.grad()[i].y != reference.grad()[i].y) ++mismatches;
+    }
+    check(mismatches == 0, "threaded WA gradients that differ", mismatches, 0);
+    printf("WA wirelength: threaded pass checked\n");
+}
+
+// Incremental mode: after moving some modules, the same result as a full evaluation
+void testWirelengthIncremental(const FlatNetlist &netlist) {
+    std::vector<Point2<double>> pos = randomPositions<double>(netlist, 2);
+
+    Wirelength<double> incremental(netlist, 500.0);
+    incremental.setIncremental(/*tolerance=*/0.0);
+    incremental.ForwardBackward(pos);
+    for (size_t i = 0; i < pos.size(); i += 7) {
+        if (!netlist.isFixed(i)) pos[i].x += 100.0;
+    }
+    incremental.ForwardBackward(pos);
+
+    Wirelength<double> reference(netlist, 500.0);
+    reference.ForwardBackward(pos);
+    const std::vector<Point2<double>> &grad = reference.grad();
+    check(close(incremental.value(), reference.value(), 1e-12, 0.0), "incremental WA value", incremental.value(),
+          reference.value());
+    double grad_scale = 0.0, grad_err = 0.0;
+    for (size_t i = 0; i < grad.size(); ++i) {
+        grad_scale = std::max(grad_scale, std::abs(grad[i].x) + std::abs(grad[i].y));
+        grad_err = std::max(grad_err, std::abs(incremental.grad()[i].x - grad[i].x) + std::abs(incremental.grad()[i].y - grad[i].y));
+    }
+    check(grad_err <= 1e-9 * grad_scale, "incremental WA gradient error", grad_err, 0.0);
+    printf("WA wirelength: incremental pass checked\n");
+}
+
+// float32 kernels: close to double
+void testWirelengthFloat(const FlatNetlist &netlist) {
+    const std::vector<Point2<double>> pos = randomPositions<double>(netlist, 2);
+    Wirelength<double> reference(netlist, 500.0);
+    reference.ForwardBackward(pos);
+    const std::vector<Point2<double>> &grad = reference.grad();
+
+    std::vector<Point2<float>> pos_f(pos.size());
+    for (size_t i = 0; i < pos.size(); ++i) pos_f[i] = Point2<float>(pos[i].x, pos[i].y);
+    Wirelength<float> single(netlist, 500.0);
+    single.ForwardBackward(pos_f);
+    check(close(single.value(), reference.value(), 1e-5, 0.0), "float32 WA value", single.value(), reference.value());
+    double grad_scale = 0.0, grad_err = 0.0;
+    for (size_t i = 0; i < grad.size(); ++i) {
+        grad_scale = std::max(grad_scale, std::abs(grad[i].x) + std::abs(grad[i].y));
+        grad_err = std::max(grad_err, std::abs(single.grad()[i].x - grad[i].x) + std::abs(single.grad()[i].y - grad[i].y));
+    }
+    check(grad_err <= 1e-3 * grad_scale, "float32 WA gradient error", grad_err, 0.0);
+    printf("WA wirelength: float32 pass checked\n");
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    const std::string aux = benchmarkPath(argc, argv);
+    Placement placement;
+    placement.readBookshelfFormat(aux, "");
+    FlatNetlist netlist(placement);
+    printf("%s: %zu modules, %zu nets\n", aux.c_str(), netlist.numModules(), netlist.numNets());
+
+    testWirelengthFiniteDifferences(netlist);
+    testWirelengthHighFanout(netlist);
+    testWirelengthFused(netlist);
+    testWirelengthThreads(netlist);
+    testWirelengthIncremental(netlist);
+    testWirelengthFloat(netlist);
+
+    return finish();
+}